@@ -0,0 +1,37 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+// A synthetic Lox program for the front-end benchmarks: `functions`
+// functions with nested blocks, branches, both kinds of loop, calls and
+// property access, and a class every ten functions, so every phase has
+// locals to resolve and a mix of node types.  Nothing is called, so
+// the program does nothing when run.
+inline std::string generateProgram(int functions)
+{
+    std::ostringstream out;
+    for (int i = 0; i < functions; ++i)
+    {
+        out << "fun f" << i << "(a, b, c) {\n"
+            << "  var x = a * " << i << " + b / (c - 1);\n"
+            << "  {\n"
+            << "    var y = x - 1;\n"
+            << "    if (x > 10 and !(b == nil)) {\n"
+            << "      while (x > 0) x = x - \"step\".length;\n"
+            << "    } else {\n"
+            << "      for (var k = 0; k < y; k = k + 1) print k;\n"
+            << "    }\n"
+            << "  }\n"
+            << "  return f" << (i > 0 ? i - 1 : 0) << "(x, b, c);\n"
+            << "}\n";
+        if (i % 10 == 0)
+        {
+            out << "class C" << i << " {\n"
+                << "  init(v) { this.v = v; }\n"
+                << "  get() { return this.v + " << i << "; }\n"
+                << "}\n";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,379 @@
+// Runs Lox benchmark scripts and reports wall time and peak RSS as JSON.
+//
+//   bench [--runs n] [--warmup n] [--baseline file] [--save file]
+//         [--tolerance percent] [--perf] cpp-lox script...
+//   bench --generate-parse file functions
+//
+// Every script runs `warmup` times untimed and then `runs` times in a
+// fresh cpp-lox process (with --no-cache, so parsing is always measured),
+// stdout and stderr going to /dev/null.  The JSON goes to stdout and, with
+// --save, to a file.  With --baseline, each median is compared against
+// the one saved earlier, and the exit status is 1 if any benchmark got
+// slower by more than the tolerance and more than its run-to-run noise.
+//
+// With --perf, each run's hardware counters (see PerfCounters.h) are
+// read too, and their mean per run added to the JSON along with IPC.
+// Counters the machine doesn't have are left out, with a warning.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "Generate.h"
+#include "PerfCounters.h"
+
+namespace
+{
+    struct Result
+    {
+        std::string name;
+        std::vector<double> milliseconds;
+        long peakRssKb = 0;
+        int status = 0;
+        // Sums over the runs that counted them.
+        uint64_t counters[PerfCounters::EVENTS] = {};
+        int counted[PerfCounters::EVENTS] = {};
+
+        double median() const
+        {
+            std::vector<double> sorted = milliseconds;
+            std::sort(sorted.begin(), sorted.end());
+            size_t n = sorted.size();
+            return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        }
+
+        double mean() const
+        {
+            double total = 0;
+            for (double ms : milliseconds)
+                total += ms;
+            return total / milliseconds.size();
+        }
+
+        // Of a counter, per run that counted it.
+        double mean(PerfCounters::Event event) const
+        {
+            return counted[event] == 0
+                       ? 0
+                       : static_cast<double>(counters[event]) / counted[event];
+        }
+
+        double stddev() const
+        {
+            if (milliseconds.size() < 2)
+                return 0;
+            double m = mean();
+            double squares = 0;
+            for (double ms : milliseconds)
+                squares += (ms - m) * (ms - m);
+            return std::sqrt(squares / (milliseconds.size() - 1));
+        }
+    };
+
+    struct Baseline
+    {
+        double median;
+        double stddev;
+    };
+
+    std::string benchmarkName(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        size_t dot = name.rfind(".lox");
+        return dot == std::string::npos ? name : name.substr(0, dot);
+    }
+
+    struct Run
+    {
+        double milliseconds;
+        long rssKb;
+        int status;
+        std::unique_ptr<PerfCounters> counters;
+    };
+
+    // Runs the script once; returns false if it couldn't be started.
+    bool runOnce(const std::string &lox, const std::string &script,
+                 bool perf, Run &run)
+    {
+        // The child waits for the counters to be opened before exec
+        // enables them.
+        int ready[2];
+        if (perf && pipe(ready) < 0)
+            return false;
+
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            if (perf)
+            {
+                close(ready[0]);
+                close(ready[1]);
+            }
+            return false;
+        }
+        if (pid == 0)
+        {
+            if (perf)
+            {
+                char byte;
+                close(ready[1]);
+                if (read(ready[0], &byte, 1) != 1)
+                    _exit(127);
+                close(ready[0]);
+            }
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            execl(lox.c_str(), lox.c_str(), "--no-cache", script.c_str(),
+                  static_cast<char *>(nullptr));
+            _exit(127);
+        }
+
+        if (perf)
+        {
+            close(ready[0]);
+            run.counters = std::make_unique<PerfCounters>(pid);
+            if (write(ready[1], "", 1) != 1)
+                std::perror("bench");
+            close(ready[1]);
+        }
+
+        int wstatus;
+        rusage usage;
+        if (wait4(pid, &wstatus, 0, &usage) < 0)
+            return false;
+        auto end = std::chrono::steady_clock::now();
+
+        run.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        run.rssKb = usage.ru_maxrss;
+        run.status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+        return true;
+    }
+
+    std::string toJson(const std::vector<Result> &results, int runs, int warmup)
+    {
+        std::ostringstream out;
+        out.precision(3);
+        out << std::fixed;
+        out << "{\n  \"runs\": " << runs << ",\n  \"warmup\": " << warmup
+            << ",\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &result = results[i];
+            // One benchmark per line: readBaseline depends on it.
+            out << "    {\"name\": \"" << result.name << "\""
+                << ", \"median_ms\": " << result.median()
+                << ", \"stddev_ms\": " << result.stddev()
+                << ", \"min_ms\": "
+                << *std::min_element(result.milliseconds.begin(),
+                                     result.milliseconds.end())
+                << ", \"peak_rss_kb\": " << result.peakRssKb;
+            for (int event = 0; event < PerfCounters::EVENTS; ++event)
+            {
+                auto e = static_cast<PerfCounters::Event>(event);
+                if (result.counted[e] != 0)
+                    out << ", \"" << PerfCounters::names[e] << "\": "
+                        << static_cast<uint64_t>(result.mean(e));
+            }
+            // From the means: the two may not cover the same runs.
+            double cycles = result.mean(PerfCounters::CYCLES);
+            if (cycles != 0 && result.counted[PerfCounters::INSTRUCTIONS] != 0)
+                out << ", \"ipc\": "
+                    << result.mean(PerfCounters::INSTRUCTIONS) / cycles;
+            out << ", \"status\": " << result.status << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return out.str();
+    }
+
+    double numberAfter(const std::string &line, const std::string &key)
+    {
+        size_t at = line.find("\"" + key + "\": ");
+        if (at == std::string::npos)
+            return NAN;
+        return std::strtod(line.c_str() + at + key.size() + 4, nullptr);
+    }
+
+    // Reads a file written by --save.
+    std::map<std::string, Baseline> readBaseline(const std::string &path)
+    {
+        std::map<std::string, Baseline> baseline;
+        std::ifstream file{path};
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t at = line.find("\"name\": \"");
+            if (at == std::string::npos)
+                continue;
+            at += 9;
+            std::string name = line.substr(at, line.find('"', at) - at);
+            baseline[name] = Baseline{numberAfter(line, "median_ms"),
+                                      numberAfter(line, "stddev_ms")};
+        }
+        return baseline;
+    }
+
+    // Compares against the baseline on stderr; returns true if anything
+    // regressed.
+    bool compare(const std::vector<Result> &results,
+                 const std::map<std::string, Baseline> &baseline,
+                 double tolerance)
+    {
+        bool regressed = false;
+        std::fprintf(stderr, "%-20s %12s %12s %9s\n", "benchmark",
+                     "baseline ms", "median ms", "change");
+        for (const Result &result : results)
+        {
+            auto elem = baseline.find(result.name);
+            if (elem == baseline.end())
+            {
+                std::fprintf(stderr, "%-20s %12s %12.1f %9s\n",
+                             result.name.c_str(), "-", result.median(), "new");
+                continue;
+            }
+
+            const Baseline &before = elem->second;
+            double median = result.median();
+            double change = (median - before.median) / before.median * 100;
+            // Slower by more than the tolerance, and by more than the
+            // noise either run saw.
+            double noise = 2 * std::max(before.stddev, result.stddev());
+            bool worse = change > tolerance && median - before.median > noise;
+            regressed = regressed || worse;
+            std::fprintf(stderr, "%-20s %12.1f %12.1f %+8.1f%%%s\n",
+                         result.name.c_str(), before.median, median, change,
+                         worse ? "  REGRESSED" : "");
+        }
+        return regressed;
+    }
+
+    // A large program that is parsed and resolved but never run.
+    void generateParse(const std::string &path, int functions)
+    {
+        std::ofstream{path} << generateProgram(functions)
+                            << "print \"parsed\";\n";
+    }
+
+    [[noreturn]] void usage()
+    {
+        std::cerr << "Usage: bench [--runs n] [--warmup n] [--baseline file] "
+                     "[--save file] [--tolerance percent] [--perf]\n"
+                     "             cpp-lox script...\n"
+                  << "       bench --generate-parse file functions\n";
+        std::exit(64);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    int warmup = 1;
+    double tolerance = 10;
+    std::string baselinePath;
+    std::string savePath;
+    bool perf = false;
+
+    int arg = 1;
+    for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; ++arg)
+    {
+        std::string option{argv[arg]};
+        if (option == "--generate-parse" && arg + 2 < argc)
+        {
+            generateParse(argv[arg + 1], std::atoi(argv[arg + 2]));
+            return 0;
+        }
+        else if (option == "--runs" && arg + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--warmup" && arg + 1 < argc)
+            warmup = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--tolerance" && arg + 1 < argc)
+            tolerance = std::atof(argv[++arg]);
+        else if (option == "--baseline" && arg + 1 < argc)
+            baselinePath = argv[++arg];
+        else if (option == "--save" && arg + 1 < argc)
+            savePath = argv[++arg];
+        else if (option == "--perf")
+            perf = true;
+        else
+            usage();
+    }
+    if (argc - arg < 2)
+        usage();
+
+    std::string lox = argv[arg++];
+    std::vector<Result> results;
+    bool failed = false;
+    bool warned = false;
+    for (; arg < argc; ++arg)
+    {
+        Result result;
+        result.name = benchmarkName(argv[arg]);
+        std::fprintf(stderr, "running %s ...\n", result.name.c_str());
+        for (int i = 0; i < warmup + runs; ++i)
+        {
+            Run run;
+            if (!runOnce(lox, argv[arg], perf, run))
+            {
+                std::perror("bench");
+                return 1;
+            }
+            if (run.status != 0)
+                result.status = run.status;
+            if (run.counters != nullptr && !run.counters->available() && !warned)
+            {
+                run.counters->print(std::cerr);
+                warned = true;
+            }
+            if (i < warmup)
+                continue;
+            result.milliseconds.push_back(run.milliseconds);
+            result.peakRssKb = std::max(result.peakRssKb, run.rssKb);
+            for (int event = 0; run.counters != nullptr && event < PerfCounters::EVENTS; ++event)
+            {
+                auto e = static_cast<PerfCounters::Event>(event);
+                if (run.counters->available(e))
+                {
+                    result.counters[event] += run.counters->read(e);
+                    ++result.counted[event];
+                }
+            }
+        }
+        if (result.status != 0)
+        {
+            std::fprintf(stderr, "%s exited with status %d\n",
+                         result.name.c_str(), result.status);
+            failed = true;
+        }
+        results.push_back(std::move(result));
+    }
+
+    std::string json = toJson(results, runs, warmup);
+    std::cout << json;
+    if (!savePath.empty())
+        std::ofstream{savePath} << json;
+
+    if (!baselinePath.empty())
+    {
+        std::map<std::string, Baseline> baseline = readBaseline(baselinePath);
+        if (baseline.empty())
+            std::fprintf(stderr, "no baseline in %s yet\n", baselinePath.c_str());
+        else if (compare(results, baseline, tolerance))
+            return 1;
+    }
+    return failed ? 1 : 0;
+}
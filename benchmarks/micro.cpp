@@ -0,0 +1,326 @@
+// Times the interpreter's phases in isolation on generated input.
+//
+//   micro [--size n] [--depth n] [--repeat n] [scan|parse|resolve|lookup...]
+//
+// --size is the number of generated functions for the front-end phases
+// and the number of lookups (in thousands) for `lookup`; --depth is how
+// many environments deep the lookups go.  Each phase runs --repeat times
+// and the fastest run is reported, as ns per token, AST node or lookup.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Environment.h"
+#include "Error.h"
+#include "Generate.h"
+#include "Interpreter.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Scanner.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double nanoseconds(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    class NodeCounter : public ExprVisitor, public StmtVisitor
+    {
+        void count(const std::shared_ptr<Expr> &expr)
+        {
+            if (expr != nullptr)
+                expr->accept(*this);
+        }
+
+        void count(const std::shared_ptr<Stmt> &stmt)
+        {
+            if (stmt != nullptr)
+                stmt->accept(*this);
+        }
+
+        std::any node()
+        {
+            ++nodes;
+            return {};
+        }
+
+    public:
+        size_t nodes = 0;
+
+        void count(const std::vector<std::shared_ptr<Stmt>> &statements)
+        {
+            for (const std::shared_ptr<Stmt> &stmt : statements)
+                count(stmt);
+        }
+
+        std::any visitAssignExpr(AssignExpr *expr) override
+        {
+            count(expr->value);
+            return node();
+        }
+        std::any visitBinaryExpr(BinaryExpr *expr) override
+        {
+            count(expr->left);
+            count(expr->right);
+            return node();
+        }
+        std::any visitCallExpr(CallExpr *expr) override
+        {
+            count(expr->callee);
+            for (const std::shared_ptr<Expr> &argument : expr->arguments)
+                count(argument);
+            return node();
+        }
+        std::any visitGetExpr(GetExpr *expr) override
+        {
+            count(expr->object);
+            return node();
+        }
+        std::any visitGroupingExpr(GroupingExpr *expr) override
+        {
+            count(expr->expression);
+            return node();
+        }
+        std::any visitLiteralExpr(LiteralExpr *) override { return node(); }
+        std::any visitLogicalExpr(LogicalExpr *expr) override
+        {
+            count(expr->left);
+            count(expr->right);
+            return node();
+        }
+        std::any visitSetExpr(SetExpr *expr) override
+        {
+            count(expr->object);
+            count(expr->value);
+            return node();
+        }
+        std::any visitThisExpr(ThisExpr *) override { return node(); }
+        std::any visitUnaryExpr(UnaryExpr *expr) override
+        {
+            count(expr->right);
+            return node();
+        }
+        std::any visitVariableExpr(VariableExpr *) override { return node(); }
+        std::any visitIndexExpr(IndexExpr *expr) override
+        {
+            count(expr->object);
+            count(expr->index);
+            return node();
+        }
+        std::any visitIndexSetExpr(IndexSetExpr *expr) override
+        {
+            count(expr->object);
+            count(expr->index);
+            count(expr->value);
+            return node();
+        }
+
+        std::any visitBlockStmt(BlockStmt *stmt) override
+        {
+            count(stmt->statements);
+            return node();
+        }
+        std::any visitClassStmt(ClassStmt *stmt) override
+        {
+            for (const std::shared_ptr<FunctionStmt> &method : stmt->methods)
+                visitFunctionStmt(method.get());
+            return node();
+        }
+        std::any visitExpressionStmt(ExpressionStmt *stmt) override
+        {
+            count(stmt->expression);
+            return node();
+        }
+        std::any visitFunctionStmt(FunctionStmt *stmt) override
+        {
+            count(stmt->body);
+            return node();
+        }
+        std::any visitIfStmt(IfStmt *stmt) override
+        {
+            count(stmt->condition);
+            count(stmt->thenBranch);
+            count(stmt->elseBranch);
+            return node();
+        }
+        std::any visitPrintStmt(PrintStmt *stmt) override
+        {
+            count(stmt->expression);
+            return node();
+        }
+        std::any visitReturnStmt(ReturnStmt *stmt) override
+        {
+            count(stmt->value);
+            return node();
+        }
+        std::any visitVarStmt(VarStmt *stmt) override
+        {
+            count(stmt->initializer);
+            return node();
+        }
+        std::any visitWhileStmt(WhileStmt *stmt) override
+        {
+            count(stmt->condition);
+            count(stmt->body);
+            return node();
+        }
+    };
+
+    struct Options
+    {
+        int size = 2000;
+        int depth = 4;
+        int repeat = 5;
+    };
+
+    void report(const char *phase, size_t units, const char *unit,
+                double bestNs)
+    {
+        std::printf("%-8s %10zu %-7s %10.2f ms %9.2f ns/%s\n", phase, units,
+                    unit, bestNs / 1e6, bestNs / units, unit);
+    }
+
+    void scan(const Options &options)
+    {
+        std::string source = generateProgram(options.size);
+        ErrorReporter errors;
+        double best = 1e300;
+        size_t tokens = 0;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            auto start = Clock::now();
+            std::vector<Token> scanned = Scanner{source, errors}.scanTokens();
+            best = std::min(best, nanoseconds(start, Clock::now()));
+            tokens = scanned.size();
+        }
+        report("scan", tokens, "token", best);
+    }
+
+    void parse(const Options &options)
+    {
+        std::string source = generateProgram(options.size);
+        ErrorReporter errors;
+        std::vector<Token> tokens = Scanner{source, errors}.scanTokens();
+        double best = 1e300;
+        size_t nodes = 0;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            auto start = Clock::now();
+            std::vector<std::shared_ptr<Stmt>> statements =
+                Parser{tokens, errors}.parse();
+            best = std::min(best, nanoseconds(start, Clock::now()));
+
+            NodeCounter counter;
+            counter.count(statements);
+            nodes = counter.nodes;
+        }
+        report("parse", nodes, "node", best);
+    }
+
+    void resolve(const Options &options)
+    {
+        std::string source = generateProgram(options.size);
+        ErrorReporter errors;
+        std::vector<Token> tokens = Scanner{source, errors}.scanTokens();
+        std::vector<std::shared_ptr<Stmt>> statements =
+            Parser{tokens, errors}.parse();
+        NodeCounter counter;
+        counter.count(statements);
+
+        Interpreter interpreter;
+        double best = 1e300;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            auto start = Clock::now();
+            Resolver{interpreter}.resolve(statements);
+            best = std::min(best, nanoseconds(start, Clock::now()));
+        }
+        report("resolve", counter.nodes, "node", best);
+    }
+
+    void lookup(const Options &options)
+    {
+        // A chain of `depth` scopes with a few locals each, like nested
+        // blocks inside a function, looked up from the innermost.
+        Ref<Environment> environment = makeRef<Environment>();
+        std::vector<std::string> names;
+        for (int level = 0; level < options.depth; ++level)
+        {
+            environment = makeRef<Environment>(environment);
+            for (int v = 0; v < 4; ++v)
+            {
+                std::string name = "v" + std::to_string(level) + "_" +
+                                   std::to_string(v);
+                environment->define(name, static_cast<double>(v));
+                names.push_back(name);
+            }
+        }
+
+        size_t lookups = static_cast<size_t>(options.size) * 1000;
+        double best = 1e300;
+        double sink = 0;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            auto start = Clock::now();
+            for (size_t n = 0; n < lookups; ++n)
+            {
+                size_t index = n % names.size();
+                int distance = options.depth - 1 - static_cast<int>(index / 4);
+                sink += std::any_cast<double>(
+                    environment->getAt(distance, names[index]));
+            }
+            best = std::min(best, nanoseconds(start, Clock::now()));
+        }
+        if (sink < 0)
+            std::printf("%f\n", sink);
+        report("lookup", lookups, "lookup", best);
+    }
+
+    [[noreturn]] void usage()
+    {
+        std::fprintf(stderr, "Usage: micro [--size n] [--depth n] [--repeat n] "
+                             "[scan|parse|resolve|lookup...]\n");
+        std::exit(64);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::vector<std::string> phases;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        std::string option{argv[arg]};
+        if (option == "--size" && arg + 1 < argc)
+            options.size = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--depth" && arg + 1 < argc)
+            options.depth = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--repeat" && arg + 1 < argc)
+            options.repeat = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "scan" || option == "parse" ||
+                 option == "resolve" || option == "lookup")
+            phases.push_back(option);
+        else
+            usage();
+    }
+    if (phases.empty())
+        phases = {"scan", "parse", "resolve", "lookup"};
+
+    for (const std::string &phase : phases)
+    {
+        if (phase == "scan")
+            scan(options);
+        else if (phase == "parse")
+            parse(options);
+        else if (phase == "resolve")
+            resolve(options);
+        else
+            lookup(options);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+struct Program;
+
+// Allocation tracking for runtime objects, for --alloc-profile and the
+// allocationReport() native.
+//
+// While enabled, the interpreter keeps `site` pointing at the node it is
+// running, and every environment, function (including bound methods),
+// instance, string built by `+` or returned by a native, and argument
+// vector is counted against that node's line.  Environments, functions
+// and instances are also remembered until they are destroyed, so the
+// report can tell the ones still alive from the ones freed; strings and
+// argument vectors live inside values and are only counted.  Bytes are
+// the object's own size (for strings and argument vectors, their
+// buffer), not what it refers to.
+//
+// Callers test `enabled` themselves, as with coverage; it is only set
+// before any Lox code runs.
+namespace allocations
+{
+    enum Kind
+    {
+        ENVIRONMENT,
+        FUNCTION,
+        INSTANCE,
+        STRING,
+        ARGUMENTS,
+        KINDS,
+    };
+
+    inline bool enabled = false;
+    inline thread_local const void *site = nullptr;
+
+    // Pass the object for kinds whose lifetime is tracked, and nullptr
+    // for strings and argument vectors.
+    void allocated(Kind kind, const void *object, size_t bytes);
+    void freed(const void *object);
+
+    void enable();
+
+    // Totals per kind, then the lines that allocated the most bytes.
+    // Allocations made outside the programs' nodes are on line "?".
+    void report(std::ostream &out,
+                const std::vector<std::shared_ptr<const Program>> &programs);
+}
@@ -17,17 +17,17 @@ public:
     return std::any_cast<std::string>(expr->accept(*this));
   }
 
-  std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override {
+  std::any visitBinaryExpr(BinaryExpr *expr) override {
     return parenthesize(expr->op.lexeme,
                         expr->left, expr->right);
   }
 
   std::any visitGroupingExpr(
-      std::shared_ptr<GroupingExpr> expr) override {
+      GroupingExpr *expr) override {
     return parenthesize("group", expr->expression);
   }
 
-  std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override {
+  std::any visitLiteralExpr(LiteralExpr *expr) override {
     auto& value_type = expr->value.type();
 
     if (value_type == typeid(nullptr)) {
@@ -43,7 +43,7 @@ public:
     return "Error in visitLiteralExpr: literal type not recognized.";
   }
 
-  std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override {
+  std::any visitUnaryExpr(UnaryExpr *expr) override {
     return parenthesize(expr->op.lexeme, expr->right);
   }
 
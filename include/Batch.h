@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Batch mode runs many independent scripts on a pool of worker threads,
+// each script in its own Lox instance with captured output.  Results are
+// reported in the order the scripts were given, as soon as every earlier
+// one has finished.
+namespace batch
+{
+    // Reads one script path per line; blank lines and lines starting
+    // with '#' are skipped.
+    std::vector<std::string> readManifest(const std::string &path);
+
+    // jobs <= 0 means one worker per hardware thread.  Returns the first
+    // non-zero script exit status, or 0 if every script succeeded.
+    int run(const std::vector<std::string> &scripts, int jobs, bool useCache);
+}
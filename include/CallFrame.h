@@ -0,0 +1,14 @@
+#pragma once
+
+class Environment;
+class FunctionStmt;
+
+// A Lox function being called, as the interpreter keeps them for the
+// profiler and heap snapshots.
+struct CallFrame
+{
+  const FunctionStmt *function;
+  // Where the caller was when it made the call.  Its executeBlock keeps
+  // it alive until the call returns.
+  Environment *caller;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <unordered_map>
+
+struct Program;
+
+// Execution counts per AST node, for --coverage.
+//
+// While enabled, the interpreter counts every statement executed and
+// every expression evaluated, and for the nodes that branch, how often
+// the branch went one way:
+//
+//   if       the then branch was taken
+//   while    the body ran (so taken / hits is iterations per loop)
+//   and, or  the right operand was evaluated
+//
+// Counts live in a table per thread, keyed by node, and are added up
+// when the report is written.  Callers test `enabled` themselves, so
+// while off the cost is one load and branch per node even in unoptimised
+// builds; it is only set before any Lox code runs.
+namespace coverage
+{
+    struct Counts
+    {
+        uint64_t hits = 0;
+        uint64_t taken = 0;
+    };
+
+    inline bool enabled = false;
+
+    // This thread's table.
+    std::unordered_map<const void *, Counts> &counts();
+
+    inline void hit(const void *node)
+    {
+        ++counts()[node].hits;
+    }
+
+    inline void taken(const void *node)
+    {
+        ++counts()[node].taken;
+    }
+
+    void enable();
+
+    // The hottest lines of a program, then its source with each line's
+    // execution count and branch ratios.  A line's count is the most any
+    // one node on it ran; its "nodes" are all node executions on it.
+    //
+    // Reads every thread's table, so call it only once no Lox code is
+    // running: after Interpreter::interpret() returns, which waits for
+    // the tasks the program spawned.
+    void report(std::ostream &out, std::string_view source,
+                const Program &program);
+}
@@ -6,31 +6,51 @@
 #include <string>
 
 #include "Token.h"
+#include "Ref.h"
 #include "RuntimeError.h"
+#include "Allocations.h"
+#include "Stats.h"
 
-class Environment: public std::enable_shared_from_this<Environment>
+class Environment : public RefCounted
 {
+    friend class HeapImage;
+    friend class HeapSnapshot;
+    friend class Transfer;
+
 private:
     std::map<std::string, std::any> values;
-    std::shared_ptr<Environment> enclosing;
+    Ref<Environment> enclosing;
+    // Set on the copies parallelFor workers get: the variables they
+    // capture are shared by every iteration and must stay read-only.
+    bool frozen = false;
+
+    void checkAssignable(const Token &name) const;
 
 public:
     Environment()
         : enclosing{nullptr}
     {
+        stats::add(stats::ENVIRONMENTS);
+        if (allocations::enabled)
+            allocations::allocated(allocations::ENVIRONMENT, this,
+                                   sizeof(Environment));
     }
 
-    Environment(std::shared_ptr<Environment> enclosing)
+    Environment(Ref<Environment> enclosing)
         : enclosing{std::move(enclosing)}
     {
+        stats::add(stats::ENVIRONMENTS);
+        if (allocations::enabled)
+            allocations::allocated(allocations::ENVIRONMENT, this,
+                                   sizeof(Environment));
     }
     
     ~Environment();
 
     void define(const std::string &name, std::any value);
-    std::any get(Token name);
+    std::any get(const Token &name);
 
-    std::shared_ptr<Environment> ancestor(int distance);
+    Environment *ancestor(int distance);
     std::any getAt(int distance, const std::string& name);
     void assign(const Token &name, std::any value);
     void assignAt(int distance, const Token &name, std::any value);
@@ -5,35 +5,56 @@
 #include "Token.h"
 #include "RuntimeError.h"
 
-inline bool hadError = false;
-inline bool hadRuntimeError = false;
-
-static void report(int line, std::string_view where,
-                   std::string_view message)
+// Error state of one interpreter.  Every Scanner, Parser and Resolver
+// reports into the ErrorReporter of the interpreter it works for, so
+// several interpreters can live side by side in one process.
+class ErrorReporter
 {
-  std::cerr << "[line " << line << "] Error" << where << ": " << message << "\n";
-  hadError = true;
-}
+  std::ostream *err;
 
-inline void error(int line, std::string_view message)
-{
-  report(line, "", message);
-}
+  void report(int line, std::string_view where, std::string_view message)
+  {
+    *err << "[line " << line << "] Error" << where << ": " << message << "\n";
+    hadError = true;
+  }
 
-inline void error(const Token &token, std::string_view message)
-{
-  if (token.type == END_OF_FILE)
+public:
+  bool hadError = false;
+  bool hadRuntimeError = false;
+
+  explicit ErrorReporter(std::ostream &err = std::cerr)
+      : err{&err}
   {
-    report(token.line, " at end", message);
   }
-  else
+
+  std::ostream &stream() { return *err; }
+
+  void error(int line, std::string_view message)
   {
-    report(token.line, " at '" + token.lexeme + "'", message);
+    report(line, "", message);
   }
-}
 
-inline void runtimeError(const RuntimeError &error)
-{
-  std::cerr << "[line " << error.token.line << "]\n"<<error.what();
-  hadRuntimeError = true;
-}
\ No newline at end of file
+  void error(const Token &token, std::string_view message)
+  {
+    if (token.type == END_OF_FILE)
+    {
+      report(token.line, " at end", message);
+    }
+    else
+    {
+      report(token.line, " at '" + token.lexeme + "'", message);
+    }
+  }
+
+  void runtimeError(const RuntimeError &error)
+  {
+    *err << error.what() << "\n[line " << error.token.line << "]\n";
+    hadRuntimeError = true;
+  }
+
+  void reset()
+  {
+    hadError = false;
+    hadRuntimeError = false;
+  }
+};
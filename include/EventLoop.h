@@ -0,0 +1,129 @@
+#pragma once
+
+#include <any>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <vector>
+#include <ucontext.h>
+#include "CallFrame.h"
+#include "Ref.h"
+#include "RuntimeError.h"
+
+class Environment;
+class Interpreter;
+
+// A stackful coroutine started by async().  It runs a Lox function on a
+// stack of its own, so it can suspend from any call depth.  Stacks are
+// reserved with mmap and only the pages actually touched are committed,
+// which keeps an idle coroutine down to a few KiB.
+class Coroutine : public RefCounted
+{
+  friend class EventLoop;
+
+  ucontext_t context;
+  char *stack = nullptr;
+  std::any function;
+  Ref<Environment> environment;
+  std::vector<CallFrame> frames; // while suspended
+
+  bool done = false;
+  bool awaited = false;
+  std::any result;
+  std::optional<RuntimeError> error;
+  std::vector<Ref<Coroutine>> waiters;
+
+public:
+  ~Coroutine();
+};
+
+// Per-interpreter event loop driving coroutines, timers and file reads.
+//
+//   var c = async(fetch);   // queued, starts when the main script waits
+//   sleep(100);             // suspends the caller for 100 ms
+//   readFile("data.txt");   // suspends the caller until the read is done
+//   print await(c);         // suspends the caller until c has finished
+//
+// The main script is not a coroutine: when it waits, it runs the loop
+// itself until what it waits for is ready.  Coroutines always switch
+// back to the main script when they suspend, and it picks the next one
+// to run.  Timers and I/O completions are collected with epoll; files
+// are read on the Scheduler pool, which signals the loop through an
+// eventfd; while a read is pending, the loop runs queued pool jobs
+// instead of blocking.  Everything else stays on the interpreter's own
+// thread.
+class EventLoop
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Results of reads running on other threads; shared with them so a
+  // late completion never touches a destroyed loop.
+  struct Completions;
+
+private:
+  struct Timer
+  {
+    Clock::time_point deadline;
+    Ref<Coroutine> coroutine; // null for the main script
+
+    bool operator>(const Timer &other) const
+    {
+      return deadline > other.deadline;
+    }
+  };
+
+  Interpreter &interpreter;
+  int epoll = -1;
+  std::shared_ptr<Completions> completions;
+  size_t reading = 0;
+
+  ucontext_t mainContext;
+  Coroutine *current = nullptr;
+  std::deque<Ref<Coroutine>> runnable;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  std::vector<Ref<Coroutine>> unhandled;
+  std::vector<char *> stacks;
+
+  static void start(unsigned int high, unsigned int low);
+  void finish(Coroutine &coroutine);
+  void resume(const Ref<Coroutine> &coroutine);
+  void suspend();
+  void poll();
+
+  // Blocks the caller until ready() holds: a coroutine suspends, the
+  // main script runs the loop.  Whatever makes ready() true must also
+  // wake the coroutine that is waiting for it.
+  template <class Ready>
+  void wait(Ready ready);
+
+public:
+  static constexpr size_t STACK_SIZE = 1024 * 1024;
+  // Lox calls fail with "Stack overflow." once less than this is left.
+  static constexpr size_t STACK_RESERVE = 64 * 1024;
+
+  explicit EventLoop(Interpreter &interpreter);
+  ~EventLoop();
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  Ref<Coroutine> spawn(std::any function);
+  std::any await(const Ref<Coroutine> &coroutine);
+  void sleep(double milliseconds);
+  std::string readFile(const std::string &path);
+
+  // Whether the running coroutine is within STACK_RESERVE of the end
+  // of its stack.  The main script's stack isn't checked.
+  bool stackExhausted() const;
+
+  // Runs until no coroutine, timer or read is left, then reports the
+  // errors of coroutines nobody awaited.
+  void run();
+
+  // Installs async, await, sleep and readFile.
+  static void defineNatives(Environment &globals);
+};
@@ -4,6 +4,7 @@
 #include <memory>
 #include <utility> // std::move
 #include <vector>
+#include "Stats.h"
 #include "Token.h"
 
 struct AssignExpr;
@@ -17,30 +18,39 @@ struct VariableExpr;
 struct GetExpr;
 struct SetExpr;
 struct ThisExpr;
+struct IndexExpr;
+struct IndexSetExpr;
 
 struct ExprVisitor
 {
-  virtual std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) = 0;
+  virtual std::any visitAssignExpr(AssignExpr *expr) = 0;
   
-  virtual std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) = 0;
-  virtual std::any visitCallExpr(std::shared_ptr<CallExpr> expr) = 0;
-  virtual std::any visitGetExpr(std::shared_ptr<GetExpr> expr) = 0;
-  virtual std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) = 0;
-  virtual std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) = 0;
-  virtual std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) = 0;
-  virtual std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) = 0;
-  virtual std::any visitSetExpr(std::shared_ptr<SetExpr> expr) = 0;
-  virtual std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) = 0;
-  virtual std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) = 0;
+  virtual std::any visitBinaryExpr(BinaryExpr *expr) = 0;
+  virtual std::any visitCallExpr(CallExpr *expr) = 0;
+  virtual std::any visitGetExpr(GetExpr *expr) = 0;
+  virtual std::any visitUnaryExpr(UnaryExpr *expr) = 0;
+  virtual std::any visitGroupingExpr(GroupingExpr *expr) = 0;
+  virtual std::any visitLiteralExpr(LiteralExpr *expr) = 0;
+  virtual std::any visitLogicalExpr(LogicalExpr *expr) = 0;
+  virtual std::any visitSetExpr(SetExpr *expr) = 0;
+  virtual std::any visitThisExpr(ThisExpr *expr) = 0;
+  virtual std::any visitVariableExpr(VariableExpr *expr) = 0;
+  virtual std::any visitIndexExpr(IndexExpr *expr) = 0;
+  virtual std::any visitIndexSetExpr(IndexSetExpr *expr) = 0;
   virtual ~ExprVisitor() = default;
 };
 
 struct Expr
 {
+  // Scope distance the Resolver found for variable, assignment and 'this'
+  // nodes; -1 means the name is global.
+  int depth = -1;
+
+  Expr() { stats::add(stats::NODES); }
   virtual std::any accept(ExprVisitor &visitor) = 0;
 };
 
-struct BinaryExpr : Expr, public std::enable_shared_from_this<BinaryExpr>
+struct BinaryExpr : Expr
 {
   BinaryExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
       : left{std::move(left)},
@@ -51,7 +61,7 @@ struct BinaryExpr : Expr, public std::enable_shared_from_this<BinaryExpr>
 
   std::any accept(ExprVisitor &visitor)
   {
-    return visitor.visitBinaryExpr(shared_from_this());
+    return visitor.visitBinaryExpr(this);
   }
 
   const std::shared_ptr<Expr> left;
@@ -59,7 +69,7 @@ struct BinaryExpr : Expr, public std::enable_shared_from_this<BinaryExpr>
   const std::shared_ptr<Expr> right;
 };
 
-struct GroupingExpr : Expr, public std::enable_shared_from_this<GroupingExpr>
+struct GroupingExpr : Expr
 {
   GroupingExpr(std::shared_ptr<Expr> expression)
       : expression{std::move(expression)}
@@ -68,13 +78,13 @@ struct GroupingExpr : Expr, public std::enable_shared_from_this<GroupingExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitGroupingExpr(shared_from_this());
+    return visitor.visitGroupingExpr(this);
   }
 
   const std::shared_ptr<Expr> expression;
 };
 
-struct LiteralExpr : Expr, public std::enable_shared_from_this<LiteralExpr>
+struct LiteralExpr : Expr
 {
   LiteralExpr(std::any value)
       : value{std::move(value)}
@@ -83,13 +93,13 @@ struct LiteralExpr : Expr, public std::enable_shared_from_this<LiteralExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitLiteralExpr(shared_from_this());
+    return visitor.visitLiteralExpr(this);
   }
 
   const std::any value;
 };
 
-struct UnaryExpr : Expr, public std::enable_shared_from_this<UnaryExpr>
+struct UnaryExpr : Expr
 {
   UnaryExpr(Token op, std::shared_ptr<Expr> right)
       : op{std::move(op)}, right{std::move(right)}
@@ -98,14 +108,14 @@ struct UnaryExpr : Expr, public std::enable_shared_from_this<UnaryExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitUnaryExpr(shared_from_this());
+    return visitor.visitUnaryExpr(this);
   }
 
   const Token op;
   const std::shared_ptr<Expr> right;
 };
 
-struct VariableExpr : Expr, public std::enable_shared_from_this<VariableExpr>
+struct VariableExpr : Expr
 {
   VariableExpr(Token name)
       : name{std::move(name)}
@@ -114,14 +124,14 @@ struct VariableExpr : Expr, public std::enable_shared_from_this<VariableExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitVariableExpr(shared_from_this());
+    return visitor.visitVariableExpr(this);
   }
 
   const Token name;
 };
 
 
-struct LogicalExpr : Expr, public std::enable_shared_from_this<LogicalExpr>
+struct LogicalExpr : Expr
 {
   LogicalExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
       : left{std::move(left)}, op{std::move(op)}, right{std::move(right)}
@@ -130,7 +140,7 @@ struct LogicalExpr : Expr, public std::enable_shared_from_this<LogicalExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitLogicalExpr(shared_from_this());
+    return visitor.visitLogicalExpr(this);
   }
 
   const std::shared_ptr<Expr> left;
@@ -139,7 +149,7 @@ struct LogicalExpr : Expr, public std::enable_shared_from_this<LogicalExpr>
 };
 
 
-struct AssignExpr : Expr, public std::enable_shared_from_this<AssignExpr>
+struct AssignExpr : Expr
 {
   AssignExpr(Token name, std::shared_ptr<Expr> value)
       : name{std::move(name)}, value{std::move(value)}
@@ -148,7 +158,7 @@ struct AssignExpr : Expr, public std::enable_shared_from_this<AssignExpr>
 
   std::any accept(ExprVisitor &visitor) override
   {
-    return visitor.visitAssignExpr(shared_from_this());
+    return visitor.visitAssignExpr(this);
   }
 
   const Token name;
@@ -156,13 +166,13 @@ struct AssignExpr : Expr, public std::enable_shared_from_this<AssignExpr>
 };
 
 
-struct CallExpr: Expr, public std::enable_shared_from_this<CallExpr> {
+struct CallExpr: Expr {
   CallExpr(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
     : callee{std::move(callee)}, paren{std::move(paren)}, arguments{std::move(arguments)}
   {}
 
   std::any accept(ExprVisitor& visitor) override {
-    return visitor.visitCallExpr(shared_from_this());
+    return visitor.visitCallExpr(this);
   }
 
   const std::shared_ptr<Expr> callee;
@@ -170,13 +180,13 @@ struct CallExpr: Expr, public std::enable_shared_from_this<CallExpr> {
   const std::vector<std::shared_ptr<Expr>> arguments;
 };
 
-struct GetExpr: Expr, public std::enable_shared_from_this<GetExpr> {
+struct GetExpr: Expr {
   GetExpr(std::shared_ptr<Expr> object, Token name)
     : object{std::move(object)}, name{std::move(name)}
   {}
 
   std::any accept(ExprVisitor& visitor) override {
-    return visitor.visitGetExpr(shared_from_this());
+    return visitor.visitGetExpr(this);
   }
 
   const std::shared_ptr<Expr> object;
@@ -185,13 +195,13 @@ struct GetExpr: Expr, public std::enable_shared_from_this<GetExpr> {
 
 
 
-struct SetExpr: Expr, public std::enable_shared_from_this<SetExpr> {
+struct SetExpr: Expr {
   SetExpr(std::shared_ptr<Expr> object, Token name, std::shared_ptr<Expr> value)
     : object{std::move(object)}, name{std::move(name)}, value{std::move(value)}
   {}
 
   std::any accept(ExprVisitor& visitor) override {
-    return visitor.visitSetExpr(shared_from_this());
+    return visitor.visitSetExpr(this);
   }
 
   const std::shared_ptr<Expr> object;
@@ -199,14 +209,45 @@ struct SetExpr: Expr, public std::enable_shared_from_this<SetExpr> {
   const std::shared_ptr<Expr> value;
 };
 
-struct ThisExpr: Expr, public std::enable_shared_from_this<ThisExpr> {
+struct ThisExpr: Expr {
   ThisExpr(Token keyword)
     : keyword{std::move(keyword)}
   {}
 
   std::any accept(ExprVisitor& visitor) override {
-    return visitor.visitThisExpr(shared_from_this());
+    return visitor.visitThisExpr(this);
   }
 
   const Token keyword;
 };
+
+struct IndexExpr: Expr {
+  IndexExpr(std::shared_ptr<Expr> object, Token bracket, std::shared_ptr<Expr> index)
+    : object{std::move(object)}, bracket{std::move(bracket)}, index{std::move(index)}
+  {}
+
+  std::any accept(ExprVisitor& visitor) override {
+    return visitor.visitIndexExpr(this);
+  }
+
+  const std::shared_ptr<Expr> object;
+  const Token bracket;
+  const std::shared_ptr<Expr> index;
+};
+
+struct IndexSetExpr: Expr {
+  IndexSetExpr(std::shared_ptr<Expr> object, Token bracket, std::shared_ptr<Expr> index,
+               std::shared_ptr<Expr> value)
+    : object{std::move(object)}, bracket{std::move(bracket)}, index{std::move(index)},
+      value{std::move(value)}
+  {}
+
+  std::any accept(ExprVisitor& visitor) override {
+    return visitor.visitIndexSetExpr(this);
+  }
+
+  const std::shared_ptr<Expr> object;
+  const Token bracket;
+  const std::shared_ptr<Expr> index;
+  const std::shared_ptr<Expr> value;
+};
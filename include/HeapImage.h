@@ -0,0 +1,99 @@
+#pragma once
+
+#include <any>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "LoxArray.h"
+#include "LoxMap.h"
+#include "Ref.h"
+#include "Stmt.h"
+
+class Interpreter;
+class Environment;
+class LoxFunction;
+class LoxClass;
+class LoxInstance;
+class AstWriter;
+class AstReader;
+
+// A heap image is a snapshot of everything reachable from the globals of
+// an interpreter that has run a prelude: environments, functions and
+// their closures, classes, instances, arrays, maps, and the AST of every
+// program it has run (preludes of earlier images included), which the
+// functions point into.  Objects refer to each other by index rather than address,
+// so an image can be mapped into any process and rebuilt.  Layout:
+//
+//   magic "LOXI" | u32 version | u64 payload size | u64 payload hash
+//   | payload = prelude AST | objects | contents
+//
+// "objects" lists every object in an order where whatever its
+// constructor needs comes first; "contents" then fills in environment
+// bindings, instance fields, array elements and map entries, which is
+// where cycles live.
+class HeapImage
+{
+    enum ObjectKind : uint8_t
+    {
+        ENVIRONMENT,
+        FUNCTION,
+        CLASS,
+        INSTANCE,
+        ARRAY,
+        MAP,
+    };
+
+    enum ValueTag : uint8_t
+    {
+        VALUE_NIL,
+        VALUE_FALSE,
+        VALUE_TRUE,
+        VALUE_NUMBER,
+        VALUE_STRING,
+        VALUE_OBJECT,
+        VALUE_NATIVE,
+    };
+
+    static constexpr uint32_t NO_OBJECT = 0xffffffff;
+
+    // The global name a native is installed under, or "" for other values.
+    static std::string nativeName(const std::any &value);
+
+    // writing
+    const AstWriter *ast = nullptr;
+    std::unordered_map<const void *, uint32_t> ids;
+    std::vector<Ref<Environment>> environments;
+    std::vector<Ref<LoxInstance>> instances;
+    std::vector<Ref<LoxArray>> arrays;
+    std::vector<Ref<LoxMap>> maps;
+    std::string objects;
+    std::string contents;
+
+    uint32_t add(const void *object);
+    uint32_t visit(const Ref<Environment> &environment);
+    uint32_t visit(const Ref<LoxFunction> &function);
+    uint32_t visit(const Ref<LoxClass> &klass);
+    uint32_t visit(const Ref<LoxInstance> &instance);
+    uint32_t visit(const Ref<LoxArray> &array);
+    uint32_t visit(const Ref<LoxMap> &map);
+    void writeValue(const std::any &value);
+
+    // reading
+    std::vector<std::any> heap;
+
+    template <class T>
+    Ref<T> object(uint32_t id) const;
+    std::any readValue(AstReader &reader);
+
+public:
+    static constexpr char MAGIC[4] = {'L', 'O', 'X', 'I'};
+    static constexpr uint32_t VERSION = 2;
+
+    // Returns false if the image could not be written.
+    bool write(const std::string &path, const Interpreter &interpreter);
+
+    // Returns false, leaving the interpreter untouched, when the image is
+    // missing or corrupt.
+    bool load(const std::string &path, Interpreter &interpreter);
+};
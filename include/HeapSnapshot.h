@@ -0,0 +1,105 @@
+#pragma once
+
+#include <any>
+#include <csignal>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Interpreter;
+class Environment;
+class LoxFunction;
+class LoxClass;
+class LoxInstance;
+class LoxArray;
+class LoxMap;
+
+// A graph of every runtime object reachable from an interpreter's
+// globals, its current environment and the environments of the calls in
+// progress.  Nodes are environments, functions, classes, instances,
+// arrays, maps and bound native methods.  Edges are named after the
+// variable, field, method, index or key they stand for, or "enclosing",
+// "closure", "class" and "receiver".  Strings are counted in the size of
+// whatever holds them.
+//
+// The retained size of an object is what freeing it would free: its own
+// size plus that of every object only reachable through it, found from
+// the dominator tree (Cooper, Harvey and Kennedy's iterative algorithm).
+// Sizes are estimates: the object plus its containers' buffers.
+//
+// Taken by heapSnapshot([path]), or when the process gets SIGUSR2, at
+// the next statement any interpreter runs.
+class HeapSnapshot
+{
+    struct Node
+    {
+        const char *type;
+        std::string name;
+        uint64_t size;
+        uint64_t retained = 0;
+    };
+
+    struct Edge
+    {
+        uint32_t from;
+        uint32_t to;
+        std::string name;
+    };
+
+    enum Kind
+    {
+        ENVIRONMENT,
+        FUNCTION,
+        CLASS,
+        INSTANCE,
+        ARRAY,
+        MAP,
+        ARRAY_METHOD,
+        MAP_METHOD,
+    };
+
+    struct Pending
+    {
+        uint32_t id;
+        Kind kind;
+        const void *object;
+    };
+
+    // Node 0 is a root standing for the interpreter itself.
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    std::unordered_map<const void *, uint32_t> ids;
+    std::vector<Pending> pending;
+
+    uint32_t add(Kind kind, const void *object, const char *type,
+                 std::string name);
+    // Adds an edge for object values; returns the bytes of string
+    // values, which count towards the holder's size.
+    uint64_t edge(uint32_t from, const std::any &value, std::string name);
+    // owner names the environment if this is the first edge to it.
+    void edge(uint32_t from, Environment *environment, std::string name,
+              std::string owner = "");
+    void expand(Pending next);
+    void computeRetained();
+
+public:
+    // Set from the SIGUSR2 handler.
+    static inline volatile std::sig_atomic_t requested = 0;
+    static void installSignalHandler();
+
+    explicit HeapSnapshot(Interpreter &interpreter);
+
+    // {"nodes": [...], "edges": [...]} with one node or edge per line.
+    bool write(const std::string &path) const;
+
+    // Object count and total size, then the `top` objects with the
+    // largest retained size.
+    void summarize(std::ostream &out, size_t top) const;
+
+    // Writes a snapshot to path, or to heap-<pid>-<n>.json if path is
+    // empty, and its summary to stderr.  Returns the path, or "" if it
+    // couldn't be written.
+    static std::string take(Interpreter &interpreter, std::string path);
+};
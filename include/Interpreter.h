@@ -3,10 +3,10 @@
 #include <any>
 #include <map>
 #include <iostream>
-#include <chrono>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include "CallFrame.h"
 #include "Error.h"
 #include "Expr.h"
 #include "RuntimeError.h"
@@ -17,75 +17,133 @@
 #include "LoxReturn.h"
 #include "LoxClass.h"
 #include "LoxInstance.h"
+#include "Native.h"
+#include "Output.h"
+#include "Program.h"
+#include "Task.h"
 
-class NativeClock : public LoxCallable
-{
-public:
-  int arity() override { return 0; }
-
-  std::any call(Interpreter &interpreter,
-                std::vector<std::any> arguments) override
-  {
-    auto ticks = std::chrono::system_clock::now().time_since_epoch();
-    return std::chrono::duration<double>{ticks}.count() / 1000.0;
-  }
-
-  std::string toString() override { return "<native fn>"; }
-};
+class EventLoop;
+class LoxArray;
+class LoxMap;
 
 class Interpreter : public ExprVisitor, public StmtVisitor
 {
   friend class LoxFunction;
+  friend class EventLoop;
+  friend class HeapSnapshot;
 
   // data
 public:
-  std::shared_ptr<Environment> globals{new Environment};
-  std::map<std::shared_ptr<Expr>, int> locals;
+  Ref<Environment> globals = makeRef<Environment>();
+  ErrorReporter errors;
 
 private:
-  std::shared_ptr<Environment> environment = globals;
+  std::unique_ptr<StreamSink> stream; // when constructed with an ostream
+  Output out;
+  Ref<Environment> environment = globals;
+
+  // Functions point into the AST of the program that declared them, so
+  // every program this interpreter has run is kept alive.
+  std::vector<std::shared_ptr<const Program>> programs;
+
+  // Created by the first native that needs it.
+  std::unique_ptr<EventLoop> loop;
+
+  // The Lox functions being called, outermost first.  A suspended
+  // coroutine keeps its own frames (see EventLoop::resume).
+  std::vector<CallFrame> frames;
+
+  // Tasks spawned here that haven't been waited for.  They print to this
+  // interpreter's output, so interpret() and the destructor wait for
+  // them.
+  std::vector<std::shared_ptr<tasks::Task>> spawned;
+
+  // The call of the native most recently entered.
+  const Token *nativeCall = nullptr;
 
 private:
-  std::any evaluate(std::shared_ptr<Expr> expr);
+  std::any evaluate(const std::shared_ptr<Expr> &expr);
   void checkNumberOperand(const Token &op, const std::any &operand);
   void checkNumberOperands(const Token &op, const std::any &left, const std::any &right);
+  LoxArray &checkIndex(const Token &bracket, const std::any &object,
+                       const std::any &index, size_t &position);
+  LoxMap *checkKey(const Token &bracket, const std::any &object,
+                   const std::any &key);
   bool isTruthy(const std::any &object);
   bool isEqual(const std::any &a, const std::any &b);
   std::string stringify(const std::any &object);
+  // Appends the printed form of a value to text.
+  void format(std::string &text, const std::any &object);
+  void format(std::string &text, LoxArray &array);
+  void format(std::string &text, LoxMap &map);
 
-  void execute(std::shared_ptr<Stmt> statement);
+  void execute(const std::shared_ptr<Stmt> &statement);
   void executeBlock(
       const std::vector<std::shared_ptr<Stmt>> &statements,
-      std::shared_ptr<Environment> environment);
+      Ref<Environment> environment);
 
     std::any lookUpVariable(const Token& name,
-                          std::shared_ptr<Expr> expr);
+                          Expr *expr);
 
 public:
-  void resolve(std::shared_ptr<Expr> expr, int depth);
-  std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
-  std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
-  std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
-  std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
-  std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
-  std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) override;
-  std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
-  std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
-  std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
-  std::any visitSetExpr(std::shared_ptr<SetExpr> expr) override;
-  std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
-
-  std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
-  std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
-  std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
-  std::any visitVarStmt(std::shared_ptr<VarStmt> stmt) override;
-  std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
-  std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
-  std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
-  std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
-  std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
-
-  void interpret(std::vector<std::shared_ptr<Stmt>> statements);
-
-  Interpreter();
+  std::any visitAssignExpr(AssignExpr *expr) override;
+  std::any visitBinaryExpr(BinaryExpr *expr) override;
+  std::any visitGroupingExpr(GroupingExpr *expr) override;
+  std::any visitLiteralExpr(LiteralExpr *expr) override;
+  std::any visitUnaryExpr(UnaryExpr *expr) override;
+  std::any visitVariableExpr(VariableExpr *expr) override;
+  std::any visitLogicalExpr(LogicalExpr *expr) override;
+  std::any visitCallExpr(CallExpr *expr) override;
+  std::any visitGetExpr(GetExpr *expr) override;
+  std::any visitSetExpr(SetExpr *expr) override;
+  std::any visitThisExpr(ThisExpr *expr) override;
+  std::any visitIndexExpr(IndexExpr *expr) override;
+  std::any visitIndexSetExpr(IndexSetExpr *expr) override;
+
+  std::any visitBlockStmt(BlockStmt *stmt) override;
+  std::any visitExpressionStmt(ExpressionStmt *stmt) override;
+  std::any visitPrintStmt(PrintStmt *stmt) override;
+  std::any visitVarStmt(VarStmt *stmt) override;
+  std::any visitIfStmt(IfStmt *stmt) override;
+  std::any visitWhileStmt(WhileStmt *stmt) override;
+  std::any visitFunctionStmt(FunctionStmt *stmt) override;
+  std::any visitReturnStmt(ReturnStmt *stmt) override;
+  std::any visitClassStmt(ClassStmt *stmt) override;
+
+  void interpret(const std::shared_ptr<const Program> &program);
+
+  // Keeps a program's AST alive for as long as this interpreter, for
+  // functions created by something other than interpret().
+  void retain(std::shared_ptr<const Program> program);
+  const std::vector<std::shared_ptr<const Program>> &retained() const
+  {
+    return programs;
+  }
+
+  // Calls a function, class or native; paren is where errors about the
+  // call itself are reported.
+  std::any call(const Token &paren, const std::any &callee,
+                std::vector<std::any> arguments);
+
+  Output &output() { return out; }
+
+  // Where the running native was called from, for natives that call
+  // back into Lox.  Only valid until that native calls another.
+  const Token &callSite() const { return *nativeCall; }
+
+  EventLoop &events();
+
+  // Runs coroutines, timers and reads started by natives until none are
+  // left.  interpret() does this after the program's last statement.
+  void runEventLoop();
+
+  // Drops the (idle) event loop, so that a forked child makes its own
+  // epoll and eventfd rather than sharing its parent's.
+  void resetEventLoop();
+
+  std::vector<std::shared_ptr<tasks::Task>> &spawnedTasks() { return spawned; }
+
+  Interpreter(std::ostream &out = std::cout, std::ostream &err = std::cerr);
+  explicit Interpreter(OutputSink &out, std::ostream &err = std::cerr);
+  ~Interpreter();
 };
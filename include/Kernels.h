@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// Numeric kernels over contiguous doubles, used by the bulk Array
+// methods.  They work a SIMD vector at a time (two doubles with SSE2 or
+// NEON) over several independent accumulators, so reductions may add
+// up in a different order than a left-to-right loop would and can
+// differ from one in the last bits.
+namespace kernels
+{
+    double sum(const double *a, size_t n);
+    double dot(const double *a, const double *b, size_t n);
+    // n must be at least 1.  NaN if any element is NaN.
+    double min(const double *a, size_t n);
+    double max(const double *a, size_t n);
+
+    // out[i] = a[i] + b[i], a[i] * b[i], a[i] * k.  out may alias a or b.
+    void add(double *out, const double *a, const double *b, size_t n);
+    void mul(double *out, const double *a, const double *b, size_t n);
+    void scale(double *out, const double *a, double k, size_t n);
+
+    // y[i] += alpha * x[i]
+    void axpy(double *y, double alpha, const double *x, size_t n);
+
+    // out[i] = a[0] + ... + a[i].  out may alias a.
+    void prefixSum(double *out, const double *a, size_t n);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <any>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Interpreter.h"
+#include "Program.h"
+
+// Embedding API.  A Lox owns one interpreter with its own globals, error
+// state and output; instances share nothing, so a host can run
+// many of them side by side, one per thread.
+class Lox
+{
+  Interpreter interpreter_;
+
+public:
+  enum class Status
+  {
+    OK,
+    COMPILE_ERROR,
+    RUNTIME_ERROR,
+  };
+
+  explicit Lox(std::ostream &out = std::cout, std::ostream &err = std::cerr);
+  // Prints into out instead of a stream; see Output.h.
+  explicit Lox(OutputSink &out, std::ostream &err = std::cerr);
+
+  Lox(const Lox &) = delete;
+  Lox &operator=(const Lox &) = delete;
+
+  // Returns nullptr, with the errors reported, if the source doesn't
+  // compile.  The program doesn't depend on this instance: any Lox, on
+  // any thread, can run it.
+  std::shared_ptr<const Program> compile(std::string_view source);
+
+  // Same, but goes through the .loxc cache at cachePath: a valid cache
+  // is loaded instead of compiling, and a fresh compile rewrites it.
+  std::shared_ptr<const Program> compile(std::string_view source,
+                                         const std::string &cachePath);
+
+  Status run(const std::shared_ptr<const Program> &program);
+  Status run(std::string_view source);
+
+  // Calls a global function or class.  Throws RuntimeError if the name is
+  // undefined, not callable, called with the wrong number of arguments,
+  // or the call itself fails.
+  std::any call(const std::string &name, std::vector<std::any> arguments);
+
+  void define(const std::string &name, std::any value);
+
+  // Process exit status for the errors seen so far: 64 after a compile
+  // error, 70 after a runtime error, otherwise 0.
+  int exitCode() const;
+
+  Interpreter &interpreter() { return interpreter_; }
+  ErrorReporter &errors() { return interpreter_.errors; }
+};
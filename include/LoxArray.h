@@ -0,0 +1,61 @@
+#pragma once
+
+#include <any>
+#include <string>
+#include <vector>
+#include "NativeMethod.h"
+#include "Ref.h"
+
+class Environment;
+class Token;
+
+// A growable Lox array.  Elements are stored contiguously: as plain
+// doubles for as long as every element is a number, and as boxed values
+// from the first time anything else is stored.  An array never goes back
+// to unboxed storage.
+//
+//   var a = Array(3);        // [0, 0, 0]
+//   a[0] = 1;  a.push(2);  print a.pop();  print a.length;
+//
+// Arrays of numbers also have bulk methods that run as native loops
+// (see Kernels.h): a.sum(), a.dot(b), a.min(), a.max(), a.prefixSum(),
+// and a.add(b), a.mul(b), a.scale(k), which return new arrays, and
+// y.axpy(alpha, x), which adds alpha * x to y in place.  min() and
+// max() are nan if any element is.
+class LoxArray : public RefCounted
+{
+    friend class HeapImage;
+    friend class HeapSnapshot;
+    friend class Transfer;
+
+    std::vector<double> numbers;
+    std::vector<std::any> values;
+    bool boxed = false;
+
+    void box();
+
+public:
+    LoxArray() = default;
+    LoxArray(size_t size, const std::any &fill);
+
+    size_t size() const;
+    std::any at(size_t index) const;
+    void store(size_t index, std::any value);
+    void push(std::any value);
+    std::any pop();
+
+    // Whether the elements are stored unboxed.
+    bool numeric() const;
+    // The unboxed elements, or nullptr once the array holds anything but
+    // numbers.
+    double *data();
+    const double *data() const;
+
+    // Properties: length, and the methods.
+    std::any get(const Token &name);
+
+    // Installs the Array constructor.
+    static void defineNatives(Environment &globals);
+};
+
+using ArrayMethod = NativeMethod<LoxArray>;
@@ -3,10 +3,11 @@
 #include <any>
 #include <string>
 #include <vector>
+#include "Ref.h"
 
 class Interpreter;
 
-class LoxCallable {
+class LoxCallable : public RefCounted {
 public:
   virtual int arity() = 0;
   virtual std::any call(Interpreter& interpreter,
@@ -12,18 +12,20 @@
 class Interpreter;
 //class LoxFunction;
 
-class LoxClass : public LoxCallable,
-                 public std::enable_shared_from_this<LoxClass>
+class LoxClass : public LoxCallable
 {
     friend class LoxInstance;
+    friend class HeapImage;
+    friend class HeapSnapshot;
+    friend class Transfer;
     const std::string name;
-    std::map<std::string, std::shared_ptr<LoxFunction>> methods;
+    std::map<std::string, Ref<LoxFunction>> methods;
 
 public:
     LoxClass(std::string name,
-             std::map<std::string, std::shared_ptr<LoxFunction>> methods);
+             std::map<std::string, Ref<LoxFunction>> methods);
 
-    std::shared_ptr<LoxFunction> findMethod(const std::string &name);
+    Ref<LoxFunction> findMethod(const std::string &name);
     
     std::string toString() override;
     std::any call(Interpreter &interpreter,
@@ -4,25 +4,31 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include "Environment.h"
 #include "LoxCallable.h"
 
-class Environment;
 class FunctionStmt;
+class LoxInstance;
 
 class LoxFunction : public LoxCallable
 {
-    std::shared_ptr<FunctionStmt> declaration;
-    std::shared_ptr<Environment> closure;
+    friend class HeapImage;
+    friend class HeapSnapshot;
+    friend class Transfer;
+
+    const FunctionStmt *declaration;
+    Ref<Environment> closure;
     bool isInitializer;
 
 public:
     // LoxFunction(std::shared_ptr<Function> declaration);
-    LoxFunction(std::shared_ptr<FunctionStmt> declaration,
-                std::shared_ptr<Environment> closure,
+    LoxFunction(const FunctionStmt *declaration,
+                Ref<Environment> closure,
                 bool isInitializer);
+    ~LoxFunction() override;
 
-    std::shared_ptr<LoxFunction> bind(
-        std::shared_ptr<LoxInstance> instance);
+    Ref<LoxFunction> bind(
+        Ref<LoxInstance> instance);
 
     std::string toString() override;
 
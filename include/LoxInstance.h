@@ -6,15 +6,22 @@
 #include <memory>
 #include <string>
 #include "LoxClass.h"
+#include "Ref.h"
 
+class LoxClass;
 class Token;
 
-class LoxInstance: public std::enable_shared_from_this<LoxInstance> {
-  std::shared_ptr<LoxClass> klass;
+class LoxInstance: public RefCounted {
+  friend class HeapImage;
+  friend class HeapSnapshot;
+  friend class Transfer;
+
+  Ref<LoxClass> klass;
   std::map<std::string, std::any> fields;
 
 public:
-  LoxInstance(std::shared_ptr<LoxClass> klass);
+  LoxInstance(Ref<LoxClass> klass);
+  ~LoxInstance();
   std::any get(const Token& name);
   void set(const Token& name, std::any value);
   std::string toString();
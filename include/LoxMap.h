@@ -0,0 +1,83 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "NativeMethod.h"
+#include "Ref.h"
+
+class Environment;
+class Token;
+
+// A Lox hash map with string and number keys.
+//
+//   var m = Map();
+//   m.set("a", 1);  m["b"] = 2;  print m.get("a");  print m["b"];
+//   m.has("a");  m.delete("a");  m.size;  m.keys();  m.values();
+//
+// Entries are kept in insertion order in one contiguous vector, together
+// with each key's hash, so growing the table never hashes a key twice.
+// The index over them is an open-addressing table in the style of
+// SwissTable: a byte of control metadata per slot (empty, deleted, or
+// seven bits of the hash) probed eight slots at a time, so most lookups
+// touch one group of control bytes and then the one matching entry.
+class LoxMap : public RefCounted
+{
+    friend class HeapImage;
+    friend class HeapSnapshot;
+    friend class Transfer;
+
+    struct Entry
+    {
+        std::any key; // empty once the entry has been deleted
+        std::any value;
+        uint64_t hash;
+    };
+
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    std::vector<uint8_t> control;
+    std::vector<uint32_t> slots; // entry index per full slot
+    std::vector<Entry> entries;
+    size_t live = 0;
+    size_t used = 0; // full and deleted slots
+
+    static uint64_t hash(const std::any &key);
+    static bool equal(const std::any &a, const std::any &b);
+
+    size_t find(const std::any &key, uint64_t hash) const; // slot or NONE
+    size_t freeSlot(uint64_t hash) const;
+    void rebuild(size_t capacity);
+
+public:
+    // Only strings and numbers other than NaN can be keys.
+    static bool isKey(const std::any &value);
+
+    size_t size() const;
+    // nil when the key is missing.
+    std::any at(const std::any &key) const;
+    void store(const std::any &key, std::any value);
+    bool contains(const std::any &key) const;
+    bool erase(const std::any &key);
+
+    // Calls f(key, value) for every entry in insertion order.
+    template <class F>
+    void forEach(F f) const
+    {
+        for (const Entry &entry : entries)
+        {
+            if (entry.key.has_value())
+                f(entry.key, entry.value);
+        }
+    }
+
+    // Properties: size, and the get, set, has, delete, keys and values
+    // methods.
+    std::any get(const Token &name);
+
+    // Installs the Map constructor.
+    static void defineNatives(Environment &globals);
+};
+
+using MapMethod = NativeMethod<LoxMap>;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <any>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class Environment;
+class Interpreter;
+
+// A function implemented in C++.  Natives are immutable and live as long
+// as the program, so a value holds one as a plain `const Native *`: no
+// reference count, and it can be passed between interpreters and threads
+// as it is.
+struct Native
+{
+  const char *name;
+  int arity;
+  std::any (*function)(Interpreter &interpreter,
+                       std::vector<std::any> &arguments);
+  int optional = 0; // trailing arguments that may be left out
+};
+
+// Thrown by a native to fail the call; the interpreter reports it as a
+// runtime error at the call site.
+class NativeError : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Checks a native's argument type, failing the call with `message`.
+template <class T>
+const T &expect(const std::any &value, const char *message)
+{
+  if (value.type() != typeid(T))
+    throw NativeError{message};
+  return *std::any_cast<T>(&value);
+}
+
+// Installs the built-in natives into a fresh interpreter's globals.
+void defineNatives(Environment &globals);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <any>
+#include <string>
+#include <vector>
+#include "LoxCallable.h"
+#include "Ref.h"
+
+// A method of a native object type, bound to its receiver, as returned
+// by `array.push` or `map.get`.  Each type keeps a static table of
+// Methods; binding one just pairs the receiver with a table entry.
+template <class T>
+class NativeMethod : public LoxCallable
+{
+public:
+    struct Method
+    {
+        const char *name;
+        int arity;
+        std::any (*function)(T &receiver, std::vector<std::any> &arguments);
+    };
+
+    NativeMethod(Ref<T> receiver, const Method *method)
+        : receiver{std::move(receiver)}, method{method}
+    {
+    }
+
+    // Binds the method called `name` from `methods`, or returns nullptr.
+    template <size_t N>
+    static Ref<NativeMethod> bind(T *receiver, const Method (&methods)[N],
+                                  const std::string &name)
+    {
+        for (const Method &method : methods)
+        {
+            if (name == method.name)
+                return makeRef<NativeMethod>(Ref<T>{receiver}, &method);
+        }
+        return nullptr;
+    }
+
+    int arity() override { return method->arity; }
+
+    std::any call(Interpreter &, std::vector<std::any> arguments) override
+    {
+        return method->function(*receiver, arguments);
+    }
+
+    std::string toString() override { return "<native fn>"; }
+
+    const Ref<T> receiver;
+    const Method *const method;
+};
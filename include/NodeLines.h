@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+struct Program;
+
+struct NodeLine
+{
+  const void *node; // an Expr or Stmt
+  int line;
+  const char *branch; // "if", "while", "and", "or" or nullptr
+};
+
+// The source line of every node in a program, children before their
+// parents.  A node is on the line of its own token if it has one, else
+// on that of its first child, else on its parent's.
+std::vector<NodeLine> nodeLines(const Program &program);
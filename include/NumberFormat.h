@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// How Lox prints numbers: the shortest digits that read back as the same
+// double.  Integers print without a fraction ("55"), numbers from 1e-6
+// up to 1e21 in plain notation ("0.1", "1234.5"), anything else in
+// scientific notation ("1e+21", "2.5e-07"), and the specials as "nan",
+// "inf" and "-inf".
+namespace numbers
+{
+    // Enough for any double in any of the notations above.
+    constexpr size_t MAX_LENGTH = 32;
+
+    // Writes the text into buffer, which must hold MAX_LENGTH chars, and
+    // returns its length.  Not NUL-terminated.
+    size_t format(double value, char *buffer);
+}
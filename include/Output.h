@@ -0,0 +1,80 @@
+#pragma once
+
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Where an interpreter's print output ends up.  A sink receives whole
+// buffered chunks; when a script spawns tasks, every task prints into
+// the spawner's sink, so write() may be called from several threads at
+// once.
+class OutputSink
+{
+public:
+    virtual void write(std::string_view bytes) = 0;
+    virtual ~OutputSink() = default;
+};
+
+// Forwards to a std::ostream, one write() and flush per chunk.
+class StreamSink : public OutputSink
+{
+    std::ostream &stream;
+    std::mutex mutex;
+
+public:
+    explicit StreamSink(std::ostream &stream);
+    void write(std::string_view bytes) override;
+};
+
+// Collects everything written, for hosts that capture a script's output.
+class StringSink : public OutputSink
+{
+    std::string text;
+    std::mutex mutex;
+
+public:
+    void write(std::string_view bytes) override;
+    std::string str();
+};
+
+// An interpreter's print buffer.  Values are formatted straight into
+// it, and it goes to the sink once it holds `threshold` bytes, when the
+// interpreter finishes a program or reports an error, before it blocks
+// waiting for tasks or timers, and when it is destroyed.
+class Output
+{
+    OutputSink *sink_;
+    std::string buffer_;
+    size_t threshold_;
+
+public:
+    static constexpr size_t DEFAULT_THRESHOLD = 64 * 1024;
+
+    explicit Output(OutputSink &sink, size_t threshold = DEFAULT_THRESHOLD);
+    ~Output();
+
+    Output(const Output &) = delete;
+    Output &operator=(const Output &) = delete;
+
+    // Append to buffer() and then call written().
+    std::string &buffer() { return buffer_; }
+    void written()
+    {
+        if (buffer_.size() >= threshold_)
+            flush();
+    }
+
+    void write(std::string_view text)
+    {
+        buffer_.append(text);
+        written();
+    }
+
+    void flush();
+
+    OutputSink &sink() { return *sink_; }
+    // Flushes what the old sink was owed first.
+    void setSink(OutputSink &sink);
+    void setThreshold(size_t threshold);
+};
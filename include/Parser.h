@@ -24,10 +24,11 @@ private:
     void synchronize();
 
     const std::vector<Token> &tokens;
+    ErrorReporter &errors;
     int current = 0;
 
 public:
-    Parser(const std::vector<Token> &tokens);
+    Parser(const std::vector<Token> &tokens, ErrorReporter &errors);
     ~Parser();
 
     std::vector<std::shared_ptr<Stmt>> parse();
@@ -112,7 +113,7 @@ private:
 
     ParseError error(const Token &token, std::string_view message)
     {
-        ::error(token, message);
+        errors.error(token, message);
         return ParseError{""};
     }
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <sys/types.h>
+
+// Hardware counters read with perf_event_open, for --perf and
+// `bench --perf`: cycles, instructions, branch misses, L1 data cache
+// read misses and last-level cache misses, user space only.
+//
+// Each counter is opened on its own, so whatever the CPU, kernel and
+// perf_event_paranoid allow is still counted when the rest is not (in a
+// VM without a virtual PMU, often nothing is).  Counts are scaled up when
+// the kernel had to multiplex counters.
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        EVENTS,
+    };
+
+    static const char *const names[EVENTS];
+
+private:
+    int fds[EVENTS];
+    std::string error; // why the first counter failed to open
+
+public:
+    // With pid 0, counts this process and the threads it starts from
+    // start() to stop().  Otherwise counts process pid from its next
+    // exec until it exits.
+    explicit PerfCounters(pid_t pid = 0);
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const;
+    bool available(Event event) const;
+
+    void start();
+    void stop();
+
+    // 0 for a counter that isn't available.
+    uint64_t read(Event event) const;
+
+    // A table of the counters and IPC, or why there are none.
+    void print(std::ostream &out) const;
+};
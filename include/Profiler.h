@@ -0,0 +1,37 @@
+#pragma once
+
+#include <csignal>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+#include "CallFrame.h"
+
+// A sampling profiler for Lox code, for --profile.
+//
+// A SIGPROF timer ticks every `1/hz` seconds of CPU time, and all the
+// signal handler does is count the tick on the thread it interrupted.
+// The interpreter checks the count before every statement and, when it
+// is set, records its call stack (the Lox functions being called, see
+// Interpreter::frames) with the count as weight.  Time spent in natives
+// is charged to the Lox function that called them.
+//
+// Stacks are named `<script>;outer:3;inner:10`, each function by its
+// name and the line it is declared on, which is what flamegraph.pl and
+// speedscope read as "folded" stacks.
+namespace profiler
+{
+    // Ticks not yet recorded on this thread.
+    inline thread_local volatile std::sig_atomic_t pending = 0;
+
+    void start(int hz);
+    void stop();
+
+    void sample(const std::vector<CallFrame> &frames);
+
+    // One `stack count` line per distinct stack.
+    void writeFolded(std::ostream &out);
+
+    // The `top` functions with the most samples of self time, with
+    // their self and total (self plus callees) share of all samples.
+    void printTop(std::ostream &out, size_t top);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+#include <utility> // std::move
+#include <vector>
+#include "Stmt.h"
+
+// A scanned, parsed and resolved script.  Resolver depths are stored in
+// the AST nodes themselves, so a Program is immutable once built and
+// carries everything needed to run it.  It can be shared by any number
+// of interpreters on any number of threads; environments, error state
+// and output all belong to the Interpreter running it.
+struct Program
+{
+  explicit Program(std::vector<std::shared_ptr<Stmt>> statements)
+      : statements{std::move(statements)}
+  {
+  }
+
+  const std::vector<std::shared_ptr<Stmt>> statements;
+};
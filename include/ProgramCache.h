@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Expr.h"
+#include "Stmt.h"
+
+// A .loxc file holds the resolved AST of one script so later runs can
+// skip scanning, parsing and resolving.  Layout:
+//
+//   magic "LOXC" | u32 version | u64 source hash | u64 source size
+//   | u64 payload size | u64 payload hash | payload
+//
+// The payload is the statement list in prefix order; every variable,
+// assignment and 'this' node carries the scope depth the Resolver gave it
+// (-1 for globals).
+namespace loxc
+{
+    constexpr char MAGIC[4] = {'L', 'O', 'X', 'C'};
+    constexpr uint32_t VERSION = 2;
+
+    uint64_t hash(std::string_view bytes);
+
+    // Little-endian helpers shared with other binary formats.
+    void putU32(std::string &out, uint32_t value);
+    void putU64(std::string &out, uint64_t value);
+    uint32_t getU32(const char *p);
+    uint64_t getU64(const char *p);
+
+    // foo.lox -> foo.loxc, anything else gets ".loxc" appended.
+    std::string cachePath(std::string_view scriptPath);
+
+    struct CacheError : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Writes header + payload through a temporary file and a rename, so
+    // readers never observe half a file.
+    bool writeFile(const std::string &path, std::string_view header,
+                   std::string_view payload);
+
+    // Read-only mmap of a whole file; empty when the file can't be mapped.
+    class MappedFile
+    {
+        const char *bytes = nullptr;
+        size_t length = 0;
+
+    public:
+        explicit MappedFile(const std::string &path);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+
+        const char *data() const { return bytes; }
+        size_t size() const { return length; }
+    };
+}
+
+class AstWriter : public ExprVisitor, public StmtVisitor
+{
+    std::string out;
+    std::unordered_map<const FunctionStmt *, uint32_t> functionIds;
+
+    void writeU8(uint8_t value);
+    void writeU32(uint32_t value);
+    void writeI32(int32_t value);
+    void writeString(std::string_view value);
+    void writeLiteral(const std::any &value);
+    void writeToken(const Token &token);
+    void writeDepth(const Expr *expr);
+    void writeExpr(const std::shared_ptr<Expr> &expr);
+    void writeStmt(const std::shared_ptr<Stmt> &stmt);
+    void writeFunction(const FunctionStmt *function);
+
+public:
+    void write(const std::vector<std::shared_ptr<Stmt>> &statements);
+    const std::string &bytes() const { return out; }
+
+    // Functions are numbered in the order they are written so that
+    // runtime objects can refer back to their declaration.
+    uint32_t functionId(const FunctionStmt *function) const;
+
+    std::any visitAssignExpr(AssignExpr *expr) override;
+    std::any visitBinaryExpr(BinaryExpr *expr) override;
+    std::any visitGroupingExpr(GroupingExpr *expr) override;
+    std::any visitLiteralExpr(LiteralExpr *expr) override;
+    std::any visitUnaryExpr(UnaryExpr *expr) override;
+    std::any visitVariableExpr(VariableExpr *expr) override;
+    std::any visitLogicalExpr(LogicalExpr *expr) override;
+    std::any visitCallExpr(CallExpr *expr) override;
+    std::any visitGetExpr(GetExpr *expr) override;
+    std::any visitSetExpr(SetExpr *expr) override;
+    std::any visitThisExpr(ThisExpr *expr) override;
+    std::any visitIndexExpr(IndexExpr *expr) override;
+    std::any visitIndexSetExpr(IndexSetExpr *expr) override;
+
+    std::any visitBlockStmt(BlockStmt *stmt) override;
+    std::any visitExpressionStmt(ExpressionStmt *stmt) override;
+    std::any visitPrintStmt(PrintStmt *stmt) override;
+    std::any visitVarStmt(VarStmt *stmt) override;
+    std::any visitIfStmt(IfStmt *stmt) override;
+    std::any visitWhileStmt(WhileStmt *stmt) override;
+    std::any visitFunctionStmt(FunctionStmt *stmt) override;
+    std::any visitReturnStmt(ReturnStmt *stmt) override;
+    std::any visitClassStmt(ClassStmt *stmt) override;
+};
+
+class AstReader
+{
+    const char *cursor;
+    const char *end;
+    std::vector<std::shared_ptr<FunctionStmt>> functions;
+
+    std::any readLiteral();
+    Token readToken();
+    void readDepth(Expr *expr);
+    std::shared_ptr<Expr> readExpr();
+    std::shared_ptr<Stmt> readStmt();
+    std::shared_ptr<FunctionStmt> readFunction();
+    std::vector<std::shared_ptr<Stmt>> readStmts();
+
+public:
+    AstReader(const char *begin, const char *end);
+
+    // Primitive reads, also used by formats that embed an AST.  All of
+    // them throw loxc::CacheError when the input runs out.
+    void need(size_t size);
+    uint8_t readU8();
+    uint32_t readU32();
+    int32_t readI32();
+    uint64_t readU64();
+    std::string readString();
+
+    std::vector<std::shared_ptr<Stmt>> read();
+    const char *position() const { return cursor; }
+
+    std::shared_ptr<FunctionStmt> function(uint32_t id) const;
+};
+
+// Returns false when the cache is missing, stale or corrupt; the caller
+// then falls back to compiling the source.
+bool loadProgramCache(const std::string &path, std::string_view source,
+                      std::vector<std::shared_ptr<Stmt>> &statements);
+
+// Best effort: a cache that cannot be written is simply skipped.
+void writeProgramCache(const std::string &path, std::string_view source,
+                       const std::vector<std::shared_ptr<Stmt>> &statements);
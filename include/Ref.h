@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility> // std::move, std::forward
+
+// Intrusive, single-threaded reference counting for runtime objects
+// (environments, functions, classes, instances).  The count lives in the
+// object itself, so there is no separate control block and copying a Ref
+// is a plain increment.  A Ref is one pointer wide, which also lets
+// std::any keep it inline instead of allocating.
+//
+// Counts are not atomic: runtime objects belong to the one interpreter
+// that created them and must never be shared between threads.
+class RefCounted
+{
+    template <class T>
+    friend class Ref;
+
+    uint32_t refs = 0;
+
+protected:
+    RefCounted() = default;
+    RefCounted(const RefCounted &) {}
+    RefCounted &operator=(const RefCounted &) { return *this; }
+    ~RefCounted() = default;
+
+public:
+    uint32_t refCount() const { return refs; }
+};
+
+template <class T>
+class Ref
+{
+    template <class U>
+    friend class Ref;
+
+    T *ptr = nullptr;
+
+    void retain() const
+    {
+        if (ptr != nullptr)
+            ++ptr->refs;
+    }
+
+    void release() const
+    {
+        if (ptr != nullptr && --ptr->refs == 0)
+            delete ptr;
+    }
+
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+
+    // Adopting a raw pointer is always safe, even for an object that is
+    // already owned elsewhere: this is how an object hands out 'this'.
+    explicit Ref(T *object)
+        : ptr{object}
+    {
+        retain();
+    }
+
+    Ref(const Ref &other)
+        : ptr{other.ptr}
+    {
+        retain();
+    }
+
+    Ref(Ref &&other) noexcept
+        : ptr{other.ptr}
+    {
+        other.ptr = nullptr;
+    }
+
+    template <class U,
+              class = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+    Ref(const Ref<U> &other)
+        : ptr{other.ptr}
+    {
+        retain();
+    }
+
+    template <class U,
+              class = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+    Ref(Ref<U> &&other) noexcept
+        : ptr{other.ptr}
+    {
+        other.ptr = nullptr;
+    }
+
+    ~Ref() { release(); }
+
+    Ref &operator=(const Ref &other)
+    {
+        other.retain();
+        release();
+        ptr = other.ptr;
+        return *this;
+    }
+
+    Ref &operator=(Ref &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            ptr = other.ptr;
+            other.ptr = nullptr;
+        }
+        return *this;
+    }
+
+    Ref &operator=(std::nullptr_t)
+    {
+        release();
+        ptr = nullptr;
+        return *this;
+    }
+
+    T *get() const { return ptr; }
+    T *operator->() const { return ptr; }
+    T &operator*() const { return *ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    friend bool operator==(const Ref &a, const Ref &b) { return a.ptr == b.ptr; }
+    friend bool operator!=(const Ref &a, const Ref &b) { return a.ptr != b.ptr; }
+    friend bool operator==(const Ref &a, std::nullptr_t) { return a.ptr == nullptr; }
+    friend bool operator!=(const Ref &a, std::nullptr_t) { return a.ptr != nullptr; }
+};
+
+template <class T, class... Args>
+Ref<T> makeRef(Args &&...args)
+{
+    return Ref<T>{new T(std::forward<Args>(args)...)};
+}
@@ -39,33 +39,34 @@ private:
     void endScope();
     void declare(const Token &name);
     void define(const Token &name);
-    void resolveLocal(std::shared_ptr<Expr> expr, const Token &name);
-    void resolveFunction(
-        std::shared_ptr<FunctionStmt> function, FunctionType type);
+    void resolveLocal(Expr *expr, const Token &name);
+    void resolveFunction(FunctionStmt *function, FunctionType type);
 
 public:
     Resolver(Interpreter &interpreter);
     void resolve(const std::vector<std::shared_ptr<Stmt>> &statements);
 
-    std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
-    std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
-    std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
-    std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
-    std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
-    std::any visitVariableExpr(std::shared_ptr<VariableExpr> expr) override;
-    std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
-    std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
-    std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
-    std::any visitSetExpr(std::shared_ptr<SetExpr> expr) override;
-    std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
+    std::any visitAssignExpr(AssignExpr *expr) override;
+    std::any visitBinaryExpr(BinaryExpr *expr) override;
+    std::any visitGroupingExpr(GroupingExpr *expr) override;
+    std::any visitLiteralExpr(LiteralExpr *expr) override;
+    std::any visitUnaryExpr(UnaryExpr *expr) override;
+    std::any visitVariableExpr(VariableExpr *expr) override;
+    std::any visitLogicalExpr(LogicalExpr *expr) override;
+    std::any visitCallExpr(CallExpr *expr) override;
+    std::any visitGetExpr(GetExpr *expr) override;
+    std::any visitSetExpr(SetExpr *expr) override;
+    std::any visitThisExpr(ThisExpr *expr) override;
+    std::any visitIndexExpr(IndexExpr *expr) override;
+    std::any visitIndexSetExpr(IndexSetExpr *expr) override;
 
-    std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
-    std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
-    std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
-    std::any visitVarStmt(std::shared_ptr<VarStmt> stmt) override;
-    std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
-    std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
-    std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
-    std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
-    std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
+    std::any visitBlockStmt(BlockStmt *stmt) override;
+    std::any visitExpressionStmt(ExpressionStmt *stmt) override;
+    std::any visitPrintStmt(PrintStmt *stmt) override;
+    std::any visitVarStmt(VarStmt *stmt) override;
+    std::any visitIfStmt(IfStmt *stmt) override;
+    std::any visitWhileStmt(WhileStmt *stmt) override;
+    std::any visitFunctionStmt(FunctionStmt *stmt) override;
+    std::any visitReturnStmt(ReturnStmt *stmt) override;
+    std::any visitClassStmt(ClassStmt *stmt) override;
 };
@@ -5,7 +5,7 @@
 
 class RuntimeError: public std::runtime_error {
 public:
-  const Token& token;
+  const Token token;
 
   RuntimeError(const Token& token, std::string_view message)
     : std::runtime_error{message.data()}, token{token}
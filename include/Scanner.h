@@ -5,12 +5,15 @@
 #include "Token.h"
 #include "TokenType.h"
 
+class ErrorReporter;
+
 class Scanner
 {
 
     static const std::map<std::string, TokenType> keywords;
 
     std::string_view source;
+    ErrorReporter &errors;
     std::vector<Token> tokens;
     int start = 0;
     int current = 0;
@@ -55,7 +58,7 @@ private:
     void identifier();
     bool isAlphaNumeric(char c){return isdigit(c) || isAlpha(c) ;}
 public:
-    Scanner(std::string_view source);
+    Scanner(std::string_view source, ErrorReporter &errors);
 
     std::vector<Token> scanTokens();
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool behind Lox tasks.  Every worker owns a deque:
+// it pushes and pops its own jobs at the back, and when that runs dry it
+// steals the oldest job from the front of another worker's deque.  Jobs
+// submitted from outside the pool are dealt out round-robin.
+//
+// A thread that has to wait for a job's outcome calls runOne() in its
+// wait loop, so waiting inside a task helps the pool instead of tying up
+// one of its workers.
+class Scheduler
+{
+public:
+    using Job = std::function<void()>;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next{0};
+
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    std::atomic<size_t> pending{0};
+    bool stopping = false;
+
+    bool take(size_t self, Job &job);
+    void work(size_t self);
+
+public:
+    // threads <= 0 means one worker per hardware thread.
+    explicit Scheduler(int threads = 0);
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    // The pool Lox tasks run on, started on first use.
+    static Scheduler &instance();
+
+    // Whether instance() has started its threads.  They aren't copied
+    // by fork(), so a process that forks must not have started them.
+    static bool running();
+
+    void submit(Job job);
+
+    // Runs one queued job on the calling thread.  Returns false if there
+    // was nothing to run.
+    bool runOne();
+
+    size_t size() const { return workers.size(); }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Server mode keeps a warmed-up interpreter (prelude or heap image
+// already loaded) in a master process and answers scripts sent over a
+// Unix domain socket.  The master keeps a pool of forked workers, each a
+// copy-on-write clone of the warmed interpreter, blocked in accept().  A
+// worker serves exactly one script and exits; the master forks a
+// replacement, so fork() stays off the request path.  Threads don't
+// survive fork(), so the prelude may not start the task pool, and each
+// worker gives up the event loop it inherited before running a script.
+//
+// Request:  u32 length | script source
+// Response: any number of frames  u8 kind | u32 length | bytes
+//           where kind is 'o' (stdout), 'e' (stderr) or 'x' (exit; the
+//           bytes are the u32 exit status).  'x' is always last.
+namespace server
+{
+    // Compiles and runs one script, returning the process exit status.
+    using Runner = std::function<int(std::string_view source)>;
+
+    // Never returns; exits on SIGINT or SIGTERM.
+    [[noreturn]] void serve(const std::string &socketPath, int workers,
+                            const Runner &run);
+
+    // Sends one script and copies its output to stdout/stderr.  Returns
+    // the script's exit status, or 74 if the server can't be reached.
+    int connect(const std::string &socketPath, std::string_view source);
+
+    // Sends the script 'repeat' times, discarding output, and reports
+    // round-trip latency percentiles on stderr.
+    int benchmark(const std::string &socketPath, std::string_view source,
+                  int repeat);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Process-wide counters and phase timings for --stats.  Everything is
+// off until enable() is called; while off, counting is a single branch
+// on a flag.  Counters are atomic because tasks run on other threads;
+// phase timings are only taken on the main thread.
+namespace stats
+{
+    enum Counter
+    {
+        TOKENS,
+        NODES, // created, including any the parser discards
+        ENVIRONMENTS,
+        CALLS,
+        INSTANCES,
+        ALLOCATIONS, // counted by cpp-lox's operator new only
+        BYTES_ALLOCATED,
+        COUNTERS,
+    };
+
+    enum Phase
+    {
+        LOAD, // reading a .loxc cache instead of the three below
+        SCAN,
+        PARSE,
+        RESOLVE,
+        INTERPRET,
+        PHASES,
+    };
+
+    inline std::atomic<bool> enabled{false};
+    inline std::atomic<uint64_t> counters[COUNTERS];
+    inline std::atomic<uint64_t> nanoseconds[PHASES];
+
+    inline void add(Counter counter, uint64_t n = 1)
+    {
+        if (enabled.load(std::memory_order_relaxed))
+            counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Adds the time until it goes out of scope to a phase.
+    class Timer
+    {
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit Timer(Phase phase)
+            : phase{phase}, start{std::chrono::steady_clock::now()}
+        {
+        }
+
+        ~Timer()
+        {
+            if (!enabled.load(std::memory_order_relaxed))
+                return;
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            nanoseconds[phase].fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count(),
+                std::memory_order_relaxed);
+        }
+    };
+
+    void enable();
+
+    // A table for people, and the same numbers as one line of JSON for
+    // logs.  Both include the peak RSS so far.
+    void print(std::ostream &out);
+    std::string json();
+}
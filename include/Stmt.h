@@ -19,25 +19,26 @@ struct ReturnStmt;
 
 struct StmtVisitor
 {
-  virtual std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) = 0;
-  virtual std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) = 0;
-  virtual std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) = 0;
-  virtual std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) = 0;
-  virtual std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) = 0;
-  virtual std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) = 0;
-  virtual std::any visitVarStmt(std::shared_ptr<VarStmt> stmt) = 0;
-  virtual std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) = 0;
-  virtual std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) = 0;
+  virtual std::any visitFunctionStmt(FunctionStmt *stmt) = 0;
+  virtual std::any visitClassStmt(ClassStmt *stmt) = 0;
+  virtual std::any visitBlockStmt(BlockStmt *stmt) = 0;
+  virtual std::any visitExpressionStmt(ExpressionStmt *stmt) = 0;
+  virtual std::any visitIfStmt(IfStmt *stmt) = 0;
+  virtual std::any visitPrintStmt(PrintStmt *stmt) = 0;
+  virtual std::any visitVarStmt(VarStmt *stmt) = 0;
+  virtual std::any visitWhileStmt(WhileStmt *stmt) = 0;
+  virtual std::any visitReturnStmt(ReturnStmt *stmt) = 0;
 
   virtual ~StmtVisitor() = default;
 };
 
 struct Stmt
 {
+  Stmt() { stats::add(stats::NODES); }
   virtual std::any accept(StmtVisitor &visitor) = 0;
 };
 
-struct BlockStmt : Stmt, public std::enable_shared_from_this<BlockStmt>
+struct BlockStmt : Stmt
 {
   BlockStmt(std::vector<std::shared_ptr<Stmt>> statements)
       : statements{std::move(statements)}
@@ -46,13 +47,13 @@ struct BlockStmt : Stmt, public std::enable_shared_from_this<BlockStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitBlockStmt(shared_from_this());
+    return visitor.visitBlockStmt(this);
   }
 
   const std::vector<std::shared_ptr<Stmt>> statements;
 };
 
-struct ExpressionStmt : Stmt, public std::enable_shared_from_this<ExpressionStmt>
+struct ExpressionStmt : Stmt
 {
   ExpressionStmt(std::shared_ptr<Expr> expression)
       : expression{std::move(expression)}
@@ -61,13 +62,13 @@ struct ExpressionStmt : Stmt, public std::enable_shared_from_this<ExpressionStmt
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitExpressionStmt(shared_from_this());
+    return visitor.visitExpressionStmt(this);
   }
 
   const std::shared_ptr<Expr> expression;
 };
 
-struct PrintStmt : Stmt, public std::enable_shared_from_this<PrintStmt>
+struct PrintStmt : Stmt
 {
   PrintStmt(std::shared_ptr<Expr> expression)
       : expression{std::move(expression)}
@@ -76,13 +77,13 @@ struct PrintStmt : Stmt, public std::enable_shared_from_this<PrintStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitPrintStmt(shared_from_this());
+    return visitor.visitPrintStmt(this);
   }
 
   const std::shared_ptr<Expr> expression;
 };
 
-struct VarStmt : Stmt, public std::enable_shared_from_this<VarStmt>
+struct VarStmt : Stmt
 {
   VarStmt(Token name, std::shared_ptr<Expr> initializer)
       : name{std::move(name)}, initializer{std::move(initializer)}
@@ -91,14 +92,14 @@ struct VarStmt : Stmt, public std::enable_shared_from_this<VarStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitVarStmt(shared_from_this());
+    return visitor.visitVarStmt(this);
   }
 
   const Token name;
   const std::shared_ptr<Expr> initializer;
 };
 
-struct IfStmt : Stmt, public std::enable_shared_from_this<IfStmt>
+struct IfStmt : Stmt
 {
   IfStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch)
       : condition{std::move(condition)}, thenBranch{std::move(thenBranch)}, elseBranch{std::move(elseBranch)}
@@ -107,7 +108,7 @@ struct IfStmt : Stmt, public std::enable_shared_from_this<IfStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitIfStmt(shared_from_this());
+    return visitor.visitIfStmt(this);
   }
 
   const std::shared_ptr<Expr> condition;
@@ -115,7 +116,7 @@ struct IfStmt : Stmt, public std::enable_shared_from_this<IfStmt>
   const std::shared_ptr<Stmt> elseBranch;
 };
 
-struct WhileStmt : Stmt, public std::enable_shared_from_this<WhileStmt>
+struct WhileStmt : Stmt
 {
   WhileStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body)
       : condition{std::move(condition)}, body{std::move(body)}
@@ -124,14 +125,14 @@ struct WhileStmt : Stmt, public std::enable_shared_from_this<WhileStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitWhileStmt(shared_from_this());
+    return visitor.visitWhileStmt(this);
   }
 
   const std::shared_ptr<Expr> condition;
   const std::shared_ptr<Stmt> body;
 };
 
-struct FunctionStmt : Stmt, public std::enable_shared_from_this<FunctionStmt>
+struct FunctionStmt : Stmt
 {
   FunctionStmt(Token name, std::vector<Token> params, std::vector<std::shared_ptr<Stmt>> body)
       : name{std::move(name)}, params{std::move(params)}, body{std::move(body)}
@@ -140,7 +141,7 @@ struct FunctionStmt : Stmt, public std::enable_shared_from_this<FunctionStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitFunctionStmt(shared_from_this());
+    return visitor.visitFunctionStmt(this);
   }
 
   const Token name;
@@ -148,7 +149,7 @@ struct FunctionStmt : Stmt, public std::enable_shared_from_this<FunctionStmt>
   const std::vector<std::shared_ptr<Stmt>> body;
 };
 
-struct ReturnStmt : Stmt, public std::enable_shared_from_this<ReturnStmt>
+struct ReturnStmt : Stmt
 {
   ReturnStmt(Token keyword, std::shared_ptr<Expr> value)
       : keyword{std::move(keyword)}, value{std::move(value)}
@@ -157,7 +158,7 @@ struct ReturnStmt : Stmt, public std::enable_shared_from_this<ReturnStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitReturnStmt(shared_from_this());
+    return visitor.visitReturnStmt(this);
   }
 
   const Token keyword;
@@ -165,7 +166,7 @@ struct ReturnStmt : Stmt, public std::enable_shared_from_this<ReturnStmt>
 };
 
 
-struct ClassStmt : Stmt, public std::enable_shared_from_this<ClassStmt>
+struct ClassStmt : Stmt
 {
   ClassStmt(Token name, std::vector<std::shared_ptr<FunctionStmt>> methods)
       : name{std::move(name)}, methods{std::move(methods)}
@@ -174,7 +175,7 @@ struct ClassStmt : Stmt, public std::enable_shared_from_this<ClassStmt>
 
   std::any accept(StmtVisitor &visitor) override
   {
-    return visitor.visitClassStmt(shared_from_this());
+    return visitor.visitClassStmt(this);
   }
 
   const Token name;
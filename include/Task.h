@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+
+class Environment;
+class Interpreter;
+
+// Lox tasks and channels.
+//
+//   var t = spawn(work);    // runs work() on the pool
+//   print join(t);          // waits, returns its result
+//
+//   var ch = channel();
+//   send(ch, value);  receive(ch);  close(ch);
+//
+//   parallelFor(0, n, body);            // body(i) for every i in [0, n)
+//   parallelFor(0, n, body, "sum");     // ... and adds up the results
+//
+// Every task runs in an interpreter of its own, on the work-stealing
+// Scheduler.  A spawned function starts from a copy of the spawner's
+// globals, and values passed to send() or returned to join() are copied
+// too (see Transfer), so tasks share nothing but tasks and channels.
+// A blocked join() or receive() runs other queued tasks meanwhile.
+// Tasks that are never joined are waited for when the spawning program
+// ends, or its interpreter is destroyed.  Errors a task's interpreter
+// reports itself (from coroutines nobody awaited, say) are collected
+// and passed on to the spawner's error stream by join(), or by that
+// wait, on the spawner's thread.
+//
+// parallelFor splits its range into a few chunks per worker.  Each chunk
+// runs in a fresh interpreter on a copy of the function and globals in
+// which captured variables are read-only; results are reduced in C++
+// ("sum", "product", "min" or "max"), per chunk and then across chunks.
+namespace tasks
+{
+    struct Task;
+    struct Channel;
+
+    // Installs spawn, join, channel, send, receive, close and
+    // parallelFor.
+    void defineNatives(Environment &globals);
+
+    // Waits for every task the interpreter spawned to finish, running
+    // queued tasks meanwhile, and passes on the errors they reported.
+    void waitAll(Interpreter &interpreter);
+}
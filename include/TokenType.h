@@ -7,6 +7,7 @@ enum TokenType
 {
     // Single-character tokens.
   LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
+  LEFT_BRACKET, RIGHT_BRACKET,
   COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, STAR,
 
   // One or two character tokens.
@@ -29,6 +30,7 @@ enum TokenType
 inline std::string toString(TokenType type) {
   static const std::string strings[] = {
     "LEFT_PAREN", "RIGHT_PAREN", "LEFT_BRACE", "RIGHT_BRACE",
+    "LEFT_BRACKET", "RIGHT_BRACKET",
     "COMMA", "DOT", "MINUS", "PLUS", "SEMICOLON", "SLASH", "STAR",
     "BANG", "BANG_EQUAL",
     "EQUAL", "EQUAL_EQUAL",
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Call and phase timings in the Chrome trace-event format, for --trace;
+// the file opens in Perfetto, chrome://tracing and speedscope.
+//
+// A Span covers one Lox function call, class instantiation, native call
+// or front-end phase and is recorded as a complete ("X") event when it
+// ends, so a wrapped buffer never leaves a begin without its end.  Events
+// go into a ring buffer of fixed capacity that keeps the most recent
+// ones.  To trace long runs, calls can be sampled (every nth call on a
+// thread) and short ones dropped; phases are always recorded.  While
+// tracing is off, a Span is a single branch on a flag.
+namespace trace
+{
+    enum Category
+    {
+        FUNCTION,
+        CLASS,
+        NATIVE,
+        PHASE,
+    };
+
+    struct Options
+    {
+        size_t capacity = 1 << 20; // events
+        unsigned every = 1;        // trace one call in this many
+        uint64_t minNanoseconds = 0;
+    };
+
+    inline std::atomic<bool> enabled{false};
+
+    void start(const Options &options);
+    bool write(const std::string &path);
+
+    // Whether this thread's next call is one of the sampled ones.
+    bool sampled();
+    void record(Category category, std::string_view name, int line,
+                uint64_t start, uint64_t end);
+
+    inline uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    class Span
+    {
+        Category category;
+        std::string_view name; // must outlive the span
+        int line;
+        uint64_t start = 0; // 0 when not traced
+
+    public:
+        Span(Category category, std::string_view name, int line = 0)
+            : category{category}, name{name}, line{line}
+        {
+            if (enabled.load(std::memory_order_relaxed) &&
+                (category == PHASE || sampled()))
+            {
+                start = now();
+            }
+        }
+
+        ~Span()
+        {
+            if (start != 0)
+                record(category, name, line, start, now());
+        }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+    };
+}
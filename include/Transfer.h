@@ -0,0 +1,55 @@
+#pragma once
+
+#include <any>
+#include <unordered_map>
+#include <vector>
+#include "Ref.h"
+
+class Environment;
+class LoxArray;
+class LoxClass;
+class LoxFunction;
+class LoxInstance;
+class LoxMap;
+
+// Deep copies values out of one interpreter's heap into another's.
+// Runtime objects have non-atomic reference counts and must never be
+// shared between threads, so every value that crosses a task boundary
+// goes through a Transfer.
+//
+// Nil, booleans, numbers, strings, natives, tasks and channels are
+// copied as they are.  Functions, classes, instances, arrays and maps are
+// copied along with everything they reach, keeping sharing and cycles
+// intact, except that references to the source globals are redirected
+// to the target globals: a function keeps looking up global names in
+// whichever interpreter it ends up in.
+class Transfer
+{
+    Environment *from;
+    Ref<Environment> to;
+    std::unordered_map<const void *, std::any> copies;
+    std::vector<const void *> copied; // keys of copies, in order
+
+    void remember(const void *original, std::any copy);
+
+    Ref<Environment> copy(const Ref<Environment> &environment);
+    Ref<LoxFunction> copy(const Ref<LoxFunction> &function);
+    Ref<LoxClass> copy(const Ref<LoxClass> &klass);
+    Ref<LoxInstance> copy(const Ref<LoxInstance> &instance);
+    Ref<LoxArray> copy(const Ref<LoxArray> &array);
+    Ref<LoxMap> copy(const Ref<LoxMap> &map);
+
+public:
+    Transfer(const Ref<Environment> &from, Ref<Environment> to);
+
+    // Throws NativeError for values that can't leave their interpreter.
+    std::any copy(const std::any &value);
+
+    // Copies every binding of the source globals into the target
+    // globals, leaving out those that can't be copied (a coroutine, say).
+    void copyGlobals();
+
+    // Makes the target globals and every environment copied so far
+    // read-only.
+    void freeze();
+};
@@ -0,0 +1,162 @@
+#include "Allocations.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "NodeLines.h"
+
+namespace
+{
+    struct Totals
+    {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        uint64_t freed = 0;
+        uint64_t freedBytes = 0;
+    };
+
+    struct Live
+    {
+        const void *site;
+        allocations::Kind kind;
+        size_t bytes;
+    };
+
+    const char *const kindNames[allocations::KINDS] = {
+        "environment", "function", "instance", "string", "arguments",
+    };
+
+    struct State
+    {
+        std::mutex mutex; // tasks allocate on other threads
+        std::map<std::pair<const void *, allocations::Kind>, Totals> sites;
+        std::unordered_map<const void *, Live> live;
+    };
+
+    // Never destroyed: objects are still freed while statics are.
+    State &state()
+    {
+        static State *state = new State;
+        return *state;
+    }
+
+    bool tracksLifetime(allocations::Kind kind)
+    {
+        return kind != allocations::STRING && kind != allocations::ARGUMENTS;
+    }
+
+    void print(std::ostream &out, const char *label, allocations::Kind kind,
+               const Totals &totals)
+    {
+        char text[128];
+        if (tracksLifetime(kind))
+        {
+            std::snprintf(text, sizeof text,
+                          "%-8s %-12s %10llu %12llu %10llu %12llu\n", label,
+                          kindNames[kind],
+                          static_cast<unsigned long long>(totals.count),
+                          static_cast<unsigned long long>(totals.bytes),
+                          static_cast<unsigned long long>(totals.count - totals.freed),
+                          static_cast<unsigned long long>(totals.bytes - totals.freedBytes));
+        }
+        else
+        {
+            std::snprintf(text, sizeof text,
+                          "%-8s %-12s %10llu %12llu %10s %12s\n", label,
+                          kindNames[kind],
+                          static_cast<unsigned long long>(totals.count),
+                          static_cast<unsigned long long>(totals.bytes), "-",
+                          "-");
+        }
+        out << text;
+    }
+}
+
+void allocations::allocated(Kind kind, const void *object, size_t bytes)
+{
+    State &state = ::state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+    Totals &totals = state.sites[{site, kind}];
+    ++totals.count;
+    totals.bytes += bytes;
+    if (object != nullptr)
+        state.live[object] = Live{site, kind, bytes};
+}
+
+void allocations::freed(const void *object)
+{
+    State &state = ::state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+    auto elem = state.live.find(object);
+    if (elem == state.live.end())
+        return;
+
+    Totals &totals = state.sites[{elem->second.site, elem->second.kind}];
+    ++totals.freed;
+    totals.freedBytes += elem->second.bytes;
+    state.live.erase(elem);
+}
+
+void allocations::enable()
+{
+    enabled = true;
+}
+
+void allocations::report(
+    std::ostream &out,
+    const std::vector<std::shared_ptr<const Program>> &programs)
+{
+    std::unordered_map<const void *, int> lines;
+    for (const std::shared_ptr<const Program> &program : programs)
+    {
+        for (const NodeLine &node : nodeLines(*program))
+            lines.emplace(node.node, node.line);
+    }
+
+    Totals kinds[KINDS];
+    std::map<std::pair<int, Kind>, Totals> byLine;
+    {
+        State &state = ::state();
+        std::lock_guard<std::mutex> lock{state.mutex};
+        for (const auto &[key, totals] : state.sites)
+        {
+            auto elem = lines.find(key.first);
+            int line = elem == lines.end() ? 0 : elem->second;
+            for (Totals *sum : {&kinds[key.second], &byLine[{line, key.second}]})
+            {
+                sum->count += totals.count;
+                sum->bytes += totals.bytes;
+                sum->freed += totals.freed;
+                sum->freedBytes += totals.freedBytes;
+            }
+        }
+    }
+
+    char header[128];
+    std::snprintf(header, sizeof header, "%-8s %-12s %10s %12s %10s %12s\n",
+                  "line", "kind", "count", "bytes", "live", "live bytes");
+
+    out << "Allocations:\n" << header;
+    for (int kind = 0; kind < KINDS; ++kind)
+        print(out, "all", static_cast<Kind>(kind), kinds[kind]);
+
+    std::vector<std::pair<std::pair<int, Kind>, Totals>> sorted{byLine.begin(),
+                                                                byLine.end()};
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const auto &a, const auto &b)
+                     { return a.second.bytes > b.second.bytes; });
+    if (sorted.size() > 20)
+        sorted.resize(20);
+
+    out << "\nTop lines by bytes:\n" << header;
+    for (const auto &[key, totals] : sorted)
+    {
+        std::string line = key.first == 0 ? "?" : std::to_string(key.first);
+        print(out, line.c_str(), key.second, totals);
+    }
+}
@@ -0,0 +1,150 @@
+#include "Batch.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring> // std::strerror
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "Lox.h"
+#include "Output.h"
+#include "ProgramCache.h"
+
+namespace
+{
+    struct Result
+    {
+        std::string out;
+        std::string err;
+        int status = 0;
+        double milliseconds = 0;
+        bool done = false;
+    };
+
+    void runOne(const std::string &path, bool useCache, Result &result)
+    {
+        StringSink out;
+        std::ostringstream err;
+
+        std::ifstream file{path, std::ios::in | std::ios::binary};
+        if (!file)
+        {
+            err << "Failed to open file " << path << ": "
+                << std::strerror(errno) << "\n";
+            result.err = err.str();
+            result.status = 74;
+            return;
+        }
+        std::string source((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+        Lox lox{out, err};
+        std::shared_ptr<const Program> program =
+            useCache ? lox.compile(source, loxc::cachePath(path))
+                     : lox.compile(source);
+        if (program != nullptr)
+            lox.run(program);
+
+        result.out = out.str();
+        result.err = err.str();
+        result.status = lox.exitCode();
+    }
+}
+
+std::vector<std::string> batch::readManifest(const std::string &path)
+{
+    std::ifstream file{path};
+    if (!file)
+    {
+        std::cerr << "Failed to open manifest " << path << ": "
+                  << std::strerror(errno) << "\n";
+        std::exit(74);
+    }
+
+    std::vector<std::string> scripts;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        scripts.push_back(line.substr(first, last - first + 1));
+    }
+    return scripts;
+}
+
+int batch::run(const std::vector<std::string> &scripts, int jobs,
+               bool useCache)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (jobs <= 0)
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min<int>(jobs, std::max<size_t>(scripts.size(), 1));
+
+    std::vector<Result> results(scripts.size());
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    auto start = clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs; ++i)
+    {
+        workers.emplace_back([&]
+                             {
+            for (size_t index = next++; index < scripts.size(); index = next++)
+            {
+                Result result;
+                auto begin = clock::now();
+                runOne(scripts[index], useCache, result);
+                result.milliseconds =
+                    std::chrono::duration<double, std::milli>(clock::now() - begin)
+                        .count();
+                result.done = true;
+
+                std::lock_guard<std::mutex> lock{mutex};
+                results[index] = std::move(result);
+                finished.notify_all();
+            } });
+    }
+
+    int status = 0;
+    int failed = 0;
+    for (size_t index = 0; index < scripts.size(); ++index)
+    {
+        Result result;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            finished.wait(lock, [&]
+                          { return results[index].done; });
+            result = std::move(results[index]);
+        }
+
+        std::cout << "=== " << scripts[index] << " (exit " << result.status
+                  << ", " << result.milliseconds << " ms)\n"
+                  << result.out;
+        std::cout.flush();
+        std::cerr << result.err;
+
+        if (result.status != 0)
+        {
+            ++failed;
+            if (status == 0)
+                status = result.status;
+        }
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    double wall = std::chrono::duration<double, std::milli>(clock::now() - start)
+                      .count();
+    std::cout << "=== " << scripts.size() << " scripts, " << failed
+              << " failed, " << jobs << " jobs, " << wall << " ms\n";
+    return status;
+}
@@ -0,0 +1,50 @@
+#include <cstdlib> // std::malloc, std::free
+#include <new>
+#include "Stats.h"
+
+// Counting allocations for --stats means replacing the global allocation
+// functions; they still go straight to malloc.  This file is linked into
+// cpp-lox only, not libcpplox, so that linking the library doesn't
+// replace an embedder's allocator.
+
+namespace
+{
+    void *allocate(size_t size)
+    {
+        if (stats::enabled.load(std::memory_order_relaxed))
+        {
+            stats::counters[stats::ALLOCATIONS].fetch_add(
+                1, std::memory_order_relaxed);
+            stats::counters[stats::BYTES_ALLOCATED].fetch_add(
+                size, std::memory_order_relaxed);
+        }
+        return std::malloc(size == 0 ? 1 : size);
+    }
+}
+
+void *operator new(size_t size)
+{
+    if (void *memory = allocate(size))
+        return memory;
+    throw std::bad_alloc{};
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
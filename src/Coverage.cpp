@@ -0,0 +1,159 @@
+#include "Coverage.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "NodeLines.h"
+
+namespace
+{
+    using Table = std::unordered_map<const void *, coverage::Counts>;
+
+    // Every thread's table, kept after the thread exits.
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Table>> tables;
+
+    // The mutex only guards the list: the tables themselves are read
+    // unlocked, so no thread may be running Lox code meanwhile (see
+    // report()).
+    Table merged()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        Table all;
+        for (const std::shared_ptr<Table> &table : tables)
+        {
+            for (const auto &[node, counts] : *table)
+            {
+                all[node].hits += counts.hits;
+                all[node].taken += counts.taken;
+            }
+        }
+        return all;
+    }
+
+    struct Branch
+    {
+        const char *kind;
+        coverage::Counts counts;
+    };
+
+    struct Line
+    {
+        uint64_t count = 0;
+        uint64_t nodes = 0;
+        std::vector<Branch> branches;
+    };
+
+    std::string describe(const Branch &branch)
+    {
+        uint64_t hits = branch.counts.hits;
+        uint64_t taken = branch.counts.taken;
+        char text[96];
+        if (std::string{branch.kind} == "while")
+        {
+            std::snprintf(text, sizeof text, "while: %llu iterations in %llu runs",
+                          static_cast<unsigned long long>(taken),
+                          static_cast<unsigned long long>(hits));
+        }
+        else
+        {
+            std::snprintf(text, sizeof text, "%s: %s %.1f%% (%llu of %llu)",
+                          branch.kind,
+                          std::string{branch.kind} == "if" ? "taken"
+                                                           : "right side",
+                          hits == 0 ? 0.0 : 100.0 * taken / hits,
+                          static_cast<unsigned long long>(taken),
+                          static_cast<unsigned long long>(hits));
+        }
+        return text;
+    }
+}
+
+std::unordered_map<const void *, coverage::Counts> &coverage::counts()
+{
+    thread_local std::shared_ptr<Table> table = []
+    {
+        auto table = std::make_shared<Table>();
+        std::lock_guard<std::mutex> lock{mutex};
+        tables.push_back(table);
+        return table;
+    }();
+    return *table;
+}
+
+void coverage::enable()
+{
+    enabled = true;
+}
+
+void coverage::report(std::ostream &out, std::string_view source,
+                      const Program &program)
+{
+    Table table = merged();
+    std::map<int, Line> lines;
+    for (const NodeLine &node : nodeLines(program))
+    {
+        // Lines with code that never ran still get a count of 0.
+        Line &line = lines[node.line];
+        auto elem = table.find(node.node);
+        if (elem == table.end())
+            continue;
+
+        line.count = std::max(line.count, elem->second.hits);
+        line.nodes += elem->second.hits;
+        if (node.branch != nullptr)
+            line.branches.push_back(Branch{node.branch, elem->second});
+    }
+
+    std::vector<std::pair<int, const Line *>> hottest;
+    for (const auto &[number, line] : lines)
+        hottest.emplace_back(number, &line);
+    std::stable_sort(hottest.begin(), hottest.end(),
+                     [](const auto &a, const auto &b)
+                     { return a.second->nodes > b.second->nodes; });
+    if (hottest.size() > 10)
+        hottest.resize(10);
+
+    char text[64];
+    out << "Hot lines:\n";
+    std::snprintf(text, sizeof text, "%8s %12s %12s\n", "line", "count",
+                  "nodes");
+    out << text;
+    for (const auto &[number, line] : hottest)
+    {
+        std::snprintf(text, sizeof text, "%8d %12llu %12llu\n", number,
+                      static_cast<unsigned long long>(line->count),
+                      static_cast<unsigned long long>(line->nodes));
+        out << text;
+    }
+
+    out << "\nAnnotated source:\n";
+    int number = 1;
+    for (size_t start = 0; start < source.size(); ++number)
+    {
+        size_t end = source.find('\n', start);
+        if (end == std::string_view::npos)
+            end = source.size();
+        std::string_view code = source.substr(start, end - start);
+        start = end + 1;
+
+        auto elem = lines.find(number);
+        if (elem == lines.end())
+            std::snprintf(text, sizeof text, "%12s %5d: ", "-", number);
+        else
+            std::snprintf(text, sizeof text, "%12llu %5d: ",
+                          static_cast<unsigned long long>(elem->second.count),
+                          number);
+        out << text << code;
+        if (elem != lines.end())
+        {
+            for (const Branch &branch : elem->second.branches)
+                out << "  // " << describe(branch);
+        }
+        out << "\n";
+    }
+}
@@ -2,6 +2,8 @@
 
 Environment::~Environment()
 {
+    if (allocations::enabled)
+        allocations::freed(this);
 }
 
 void Environment::define(const std::string &name, std::any value)
@@ -9,7 +11,7 @@ void Environment::define(const std::string &name, std::any value)
     values[name] = std::move(value);
 }
 
-std::any Environment::get(Token name)
+std::any Environment::get(const Token &name)
 {
     auto elem = values.find(name.lexeme);
     if (elem != values.end())
@@ -30,6 +32,7 @@ void Environment::assign(const Token &name, std::any value)
 
     if (elem != values.end())
     {
+        checkAssignable(name);
         elem->second = std::move(value);
         return;
     }
@@ -44,12 +47,12 @@ void Environment::assign(const Token &name, std::any value)
                        "Undefined variable '" + name.lexeme + "'.");
 }
 
-std::shared_ptr<Environment> Environment::ancestor(int distance)
+Environment *Environment::ancestor(int distance)
 {
-    std::shared_ptr<Environment> environment = shared_from_this();
+    Environment *environment = this;
     for (int i = 0; i < distance; ++i)
     {
-        environment = environment->enclosing;
+        environment = environment->enclosing.get();
     }
 
     return environment;
@@ -61,5 +64,16 @@ std::any Environment::getAt(int distance, const std::string &name)
 
 void Environment::assignAt(int distance, const Token &name, std::any value)
 {
-    ancestor(distance)->values[name.lexeme] = std::move(value);
+    Environment *environment = ancestor(distance);
+    environment->checkAssignable(name);
+    environment->values[name.lexeme] = std::move(value);
+}
+
+void Environment::checkAssignable(const Token &name) const
+{
+    if (frozen)
+    {
+        throw RuntimeError(name, "Can't assign to captured variable '" +
+                                     name.lexeme + "' inside parallelFor.");
+    }
 }
\ No newline at end of file
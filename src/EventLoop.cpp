@@ -0,0 +1,450 @@
+#include "EventLoop.h"
+#include <algorithm> // std::clamp
+#include <cerrno>
+#include <cmath>     // std::isinf
+#include <cstdint>
+#include <cstring> // std::strerror
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Interpreter.h"
+#include "Native.h"
+#include "Scheduler.h"
+
+namespace
+{
+    constexpr size_t GUARD_SIZE = 4096;
+    constexpr size_t MAX_POOLED_STACKS = 64;
+    // About 30 years.
+    constexpr double MAX_SLEEP_MILLISECONDS = 1e12;
+
+    struct PendingRead
+    {
+        std::string path;
+
+        // Written by the reading thread before it posts the completion.
+        std::string data;
+        std::string error;
+
+        // Only touched on the loop's thread.
+        bool done = false;
+        Coroutine *waiter = nullptr;
+    };
+
+    char *allocateStack()
+    {
+        void *memory = mmap(nullptr, GUARD_SIZE + EventLoop::STACK_SIZE,
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                                MAP_STACK,
+                            -1, 0);
+        if (memory == MAP_FAILED)
+            throw NativeError{"Out of memory for coroutine stacks."};
+
+        // The stack grows down into a page that faults.
+        mprotect(memory, GUARD_SIZE, PROT_NONE);
+        return static_cast<char *>(memory);
+    }
+
+    void freeStack(char *stack)
+    {
+        munmap(stack, GUARD_SIZE + EventLoop::STACK_SIZE);
+    }
+}
+
+struct EventLoop::Completions
+{
+    int event = -1;
+    std::mutex mutex;
+    std::vector<std::shared_ptr<PendingRead>> finished;
+
+    ~Completions()
+    {
+        if (event >= 0)
+            ::close(event);
+    }
+
+    void post(std::shared_ptr<PendingRead> read)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            finished.push_back(std::move(read));
+        }
+        uint64_t one = 1;
+        ssize_t written = ::write(event, &one, sizeof one);
+        (void)written;
+    }
+};
+
+Coroutine::~Coroutine()
+{
+    if (stack != nullptr)
+        freeStack(stack);
+}
+
+EventLoop::EventLoop(Interpreter &interpreter)
+    : interpreter{interpreter}, completions{std::make_shared<Completions>()}
+{
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    completions->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll < 0 || completions->event < 0)
+    {
+        throw NativeError{std::string{"Can't start the event loop: "} +
+                          std::strerror(errno)};
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, completions->event, &event);
+}
+
+EventLoop::~EventLoop()
+{
+    ::close(epoll);
+    for (char *stack : stacks)
+        freeStack(stack);
+}
+
+// ---------------------------------------------------------------- switching
+
+void EventLoop::start(unsigned int high, unsigned int low)
+{
+    auto *loop = reinterpret_cast<EventLoop *>(
+        (static_cast<uintptr_t>(high) << 32) | low);
+    Coroutine &coroutine = *loop->current;
+
+    {
+        Token token{IDENTIFIER, "async", nullptr, 0};
+        try
+        {
+            coroutine.result =
+                loop->interpreter.call(token, coroutine.function, {});
+        }
+        catch (const RuntimeError &error)
+        {
+            coroutine.error.emplace(error);
+        }
+        catch (const std::exception &error)
+        {
+            coroutine.error.emplace(token, error.what());
+        }
+        coroutine.function = std::any{};
+    }
+
+    loop->finish(coroutine);
+
+    // Never resumed again: the main script frees this stack.
+    setcontext(&loop->mainContext);
+}
+
+void EventLoop::finish(Coroutine &coroutine)
+{
+    coroutine.done = true;
+    for (Ref<Coroutine> &waiter : coroutine.waiters)
+        runnable.push_back(std::move(waiter));
+    coroutine.waiters.clear();
+
+    if (coroutine.error && !coroutine.awaited)
+        unhandled.emplace_back(&coroutine);
+}
+
+void EventLoop::resume(const Ref<Coroutine> &coroutine)
+{
+    if (coroutine->done)
+        return;
+
+    if (coroutine->stack == nullptr)
+    {
+        if (!stacks.empty())
+        {
+            coroutine->stack = stacks.back();
+            stacks.pop_back();
+        }
+        else
+        {
+            coroutine->stack = allocateStack();
+        }
+
+        auto self = reinterpret_cast<uintptr_t>(this);
+        getcontext(&coroutine->context);
+        coroutine->context.uc_stack.ss_sp = coroutine->stack + GUARD_SIZE;
+        coroutine->context.uc_stack.ss_size = STACK_SIZE;
+        coroutine->context.uc_link = nullptr;
+        makecontext(&coroutine->context,
+                    reinterpret_cast<void (*)()>(&EventLoop::start), 2,
+                    static_cast<unsigned int>(self >> 32),
+                    static_cast<unsigned int>(self));
+        coroutine->environment = interpreter.globals;
+    }
+
+    // The interpreter's current environment belongs to whoever runs, and
+    // the coroutine's call frames go on top of the main script's.
+    Ref<Environment> saved = std::move(interpreter.environment);
+    interpreter.environment = std::move(coroutine->environment);
+    size_t base = interpreter.frames.size();
+    interpreter.frames.insert(interpreter.frames.end(),
+                              coroutine->frames.begin(),
+                              coroutine->frames.end());
+    current = coroutine.get();
+
+    swapcontext(&mainContext, &coroutine->context);
+
+    current = nullptr;
+    coroutine->environment = std::move(interpreter.environment);
+    interpreter.environment = std::move(saved);
+    coroutine->frames.assign(interpreter.frames.begin() + base,
+                             interpreter.frames.end());
+    interpreter.frames.resize(base);
+
+    if (coroutine->done)
+    {
+        coroutine->environment = nullptr;
+        if (stacks.size() < MAX_POOLED_STACKS)
+            stacks.push_back(coroutine->stack);
+        else
+            freeStack(coroutine->stack);
+        coroutine->stack = nullptr;
+    }
+}
+
+bool EventLoop::stackExhausted() const
+{
+    if (current == nullptr)
+        return false;
+    // The stack grows down towards the guard page.
+    char here;
+    return &here < current->stack + GUARD_SIZE + STACK_RESERVE;
+}
+
+void EventLoop::suspend()
+{
+    swapcontext(&current->context, &mainContext);
+}
+
+template <class Ready>
+void EventLoop::wait(Ready ready)
+{
+    if (current != nullptr)
+    {
+        // Keeps a suspended coroutine alive even if nothing else refers
+        // to it any more.
+        Ref<Coroutine> self{current};
+        while (!ready())
+            suspend();
+        return;
+    }
+
+    while (!ready())
+    {
+        if (!runnable.empty())
+        {
+            Ref<Coroutine> next = std::move(runnable.front());
+            runnable.pop_front();
+            resume(next);
+        }
+        else if (!timers.empty() || reading > 0)
+        {
+            poll();
+        }
+        else
+        {
+            throw NativeError{"Nothing left to wait for."};
+        }
+    }
+}
+
+void EventLoop::poll()
+{
+    int timeout = -1;
+    if (!timers.empty())
+    {
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(
+            timers.top().deadline - Clock::now());
+        timeout = static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(
+            left.count(), 0, std::numeric_limits<int>::max()));
+    }
+
+    // Don't sit on printed output while nothing else is happening.
+    if (timeout != 0)
+        interpreter.output().flush();
+
+    // Reads are jobs on the pool, and this may be the worker that would
+    // run them: help it rather than block.
+    if (reading > 0 && timeout != 0 && Scheduler::instance().runOne())
+        timeout = 0;
+
+    epoll_event events[4];
+    int count = epoll_wait(epoll, events, 4, timeout);
+    if (count > 0)
+    {
+        uint64_t posted;
+        ssize_t got = ::read(completions->event, &posted, sizeof posted);
+        (void)got;
+
+        std::vector<std::shared_ptr<PendingRead>> finished;
+        {
+            std::lock_guard<std::mutex> lock{completions->mutex};
+            finished.swap(completions->finished);
+        }
+        for (const std::shared_ptr<PendingRead> &read : finished)
+        {
+            --reading;
+            read->done = true;
+            if (read->waiter != nullptr)
+                runnable.emplace_back(read->waiter);
+        }
+    }
+
+    Clock::time_point now = Clock::now();
+    while (!timers.empty() && timers.top().deadline <= now)
+    {
+        if (timers.top().coroutine != nullptr)
+            runnable.push_back(timers.top().coroutine);
+        timers.pop();
+    }
+}
+
+// ---------------------------------------------------------------- operations
+
+Ref<Coroutine> EventLoop::spawn(std::any function)
+{
+    auto coroutine = makeRef<Coroutine>();
+    coroutine->function = std::move(function);
+    runnable.push_back(coroutine);
+    return coroutine;
+}
+
+std::any EventLoop::await(const Ref<Coroutine> &coroutine)
+{
+    coroutine->awaited = true;
+    if (!coroutine->done)
+    {
+        if (current != nullptr)
+            coroutine->waiters.emplace_back(current);
+        wait([&]
+             { return coroutine->done; });
+    }
+
+    for (auto elem = unhandled.begin(); elem != unhandled.end(); ++elem)
+    {
+        if (*elem == coroutine)
+        {
+            unhandled.erase(elem);
+            break;
+        }
+    }
+
+    if (coroutine->error)
+    {
+        throw NativeError{"Coroutine failed: " +
+                          std::string{coroutine->error->what()} +
+                          " [line " +
+                          std::to_string(coroutine->error->token.line) + "]"};
+    }
+    return coroutine->result;
+}
+
+void EventLoop::sleep(double milliseconds)
+{
+    Clock::time_point deadline =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double, std::milli>{
+                               milliseconds});
+    timers.push(Timer{deadline, Ref<Coroutine>{current}});
+    wait([&]
+         { return Clock::now() >= deadline; });
+}
+
+std::string EventLoop::readFile(const std::string &path)
+{
+    auto read = std::make_shared<PendingRead>();
+    read->path = path;
+    read->waiter = current;
+    ++reading;
+
+    Scheduler::instance().submit([read, completions = completions]
+                                 {
+        std::ifstream file{read->path, std::ios::in | std::ios::binary};
+        if (!file)
+            read->error = std::strerror(errno);
+        else
+            read->data.assign(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+        completions->post(read); });
+
+    wait([&]
+         { return read->done; });
+
+    if (!read->error.empty())
+        throw NativeError{"Can't read " + path + ": " + read->error + "."};
+    return std::move(read->data);
+}
+
+void EventLoop::run()
+{
+    wait([this]
+         { return runnable.empty() && timers.empty() && reading == 0; });
+
+    if (!unhandled.empty())
+        interpreter.output().flush();
+    for (const Ref<Coroutine> &coroutine : unhandled)
+        interpreter.errors.runtimeError(*coroutine->error);
+    unhandled.clear();
+}
+
+// ---------------------------------------------------------------- natives
+
+namespace
+{
+    std::any runAsync(Interpreter &interpreter,
+                      std::vector<std::any> &arguments)
+    {
+        const std::type_info &type = arguments[0].type();
+        if (type != typeid(Ref<LoxFunction>) && type != typeid(Ref<LoxClass>))
+            throw NativeError{"Can only run functions and classes async."};
+        return interpreter.events().spawn(std::move(arguments[0]));
+    }
+
+    std::any awaitCoroutine(Interpreter &interpreter,
+                            std::vector<std::any> &arguments)
+    {
+        return interpreter.events().await(expect<Ref<Coroutine>>(
+            arguments[0], "Can only await coroutines."));
+    }
+
+    std::any sleepFor(Interpreter &interpreter,
+                      std::vector<std::any> &arguments)
+    {
+        double milliseconds =
+            expect<double>(arguments[0], "Sleep time must be a number.");
+        if (!(milliseconds >= 0) || std::isinf(milliseconds))
+            throw NativeError{"Sleep time must be a finite, non-negative number."};
+        // Far enough to mean "forever" without overflowing the clock.
+        interpreter.events().sleep(std::min(milliseconds, MAX_SLEEP_MILLISECONDS));
+        return nullptr;
+    }
+
+    std::any readWholeFile(Interpreter &interpreter,
+                           std::vector<std::any> &arguments)
+    {
+        return interpreter.events().readFile(
+            expect<std::string>(arguments[0], "Path must be a string."));
+    }
+
+    const Native natives[] = {
+        {"async", 1, runAsync},
+        {"await", 1, awaitCoroutine},
+        {"sleep", 1, sleepFor},
+        {"readFile", 1, readWholeFile},
+    };
+}
+
+void EventLoop::defineNatives(Environment &globals)
+{
+    for (const Native &native : natives)
+        globals.define(native.name, &native);
+}
@@ -0,0 +1,520 @@
+#include "HeapImage.h"
+#include <cstring> // std::memcmp, std::memcpy
+#include "Interpreter.h"
+#include "LoxArray.h"
+#include "ProgramCache.h"
+
+namespace
+{
+    constexpr size_t HEADER_SIZE = 4 + 4 + 8 + 8;
+
+    void putString(std::string &out, std::string_view value)
+    {
+        loxc::putU32(out, value.size());
+        out.append(value);
+    }
+}
+
+std::string HeapImage::nativeName(const std::any &value)
+{
+    if (value.type() == typeid(const Native *))
+        return std::any_cast<const Native *>(value)->name;
+    return "";
+}
+
+// ---------------------------------------------------------------- writing
+
+uint32_t HeapImage::add(const void *object)
+{
+    uint32_t id = ids.size();
+    ids.emplace(object, id);
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<Environment> &environment)
+{
+    auto elem = ids.find(environment.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    uint32_t enclosing = environment->enclosing != nullptr
+                             ? visit(environment->enclosing)
+                             : NO_OBJECT;
+
+    uint32_t id = add(environment.get());
+    objects.push_back(ENVIRONMENT);
+    loxc::putU32(objects, enclosing);
+    environments.push_back(environment);
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<LoxFunction> &function)
+{
+    auto elem = ids.find(function.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    uint32_t closure = visit(function->closure);
+    uint32_t declaration = ast->functionId(function->declaration);
+
+    uint32_t id = add(function.get());
+    objects.push_back(FUNCTION);
+    loxc::putU32(objects, declaration);
+    loxc::putU32(objects, closure);
+    objects.push_back(function->isInitializer);
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<LoxClass> &klass)
+{
+    auto elem = ids.find(klass.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    std::vector<uint32_t> methods;
+    for (const auto &[name, method] : klass->methods)
+        methods.push_back(visit(method));
+
+    uint32_t id = add(klass.get());
+    objects.push_back(CLASS);
+    putString(objects, klass->name);
+    loxc::putU32(objects, methods.size());
+    auto method = methods.begin();
+    for (const auto &entry : klass->methods)
+    {
+        putString(objects, entry.first);
+        loxc::putU32(objects, *method++);
+    }
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<LoxInstance> &instance)
+{
+    auto elem = ids.find(instance.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    uint32_t klass = visit(instance->klass);
+
+    uint32_t id = add(instance.get());
+    objects.push_back(INSTANCE);
+    loxc::putU32(objects, klass);
+    instances.push_back(instance);
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<LoxArray> &array)
+{
+    auto elem = ids.find(array.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    uint32_t id = add(array.get());
+    objects.push_back(ARRAY);
+    arrays.push_back(array);
+    return id;
+}
+
+uint32_t HeapImage::visit(const Ref<LoxMap> &map)
+{
+    auto elem = ids.find(map.get());
+    if (elem != ids.end())
+        return elem->second;
+
+    uint32_t id = add(map.get());
+    objects.push_back(MAP);
+    maps.push_back(map);
+    return id;
+}
+
+void HeapImage::writeValue(const std::any &value)
+{
+    if (value.type() == typeid(nullptr))
+    {
+        contents.push_back(VALUE_NIL);
+    }
+    else if (value.type() == typeid(bool))
+    {
+        contents.push_back(std::any_cast<bool>(value) ? VALUE_TRUE
+                                                      : VALUE_FALSE);
+    }
+    else if (value.type() == typeid(double))
+    {
+        double number = std::any_cast<double>(value);
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof bits);
+        contents.push_back(VALUE_NUMBER);
+        loxc::putU64(contents, bits);
+    }
+    else if (value.type() == typeid(std::string))
+    {
+        contents.push_back(VALUE_STRING);
+        putString(contents, std::any_cast<const std::string &>(value));
+    }
+    else if (value.type() == typeid(Ref<LoxFunction>))
+    {
+        uint32_t id = visit(std::any_cast<Ref<LoxFunction>>(value));
+        contents.push_back(VALUE_OBJECT);
+        loxc::putU32(contents, id);
+    }
+    else if (value.type() == typeid(Ref<LoxClass>))
+    {
+        uint32_t id = visit(std::any_cast<Ref<LoxClass>>(value));
+        contents.push_back(VALUE_OBJECT);
+        loxc::putU32(contents, id);
+    }
+    else if (value.type() == typeid(Ref<LoxInstance>))
+    {
+        uint32_t id = visit(std::any_cast<Ref<LoxInstance>>(value));
+        contents.push_back(VALUE_OBJECT);
+        loxc::putU32(contents, id);
+    }
+    else if (value.type() == typeid(Ref<LoxArray>))
+    {
+        uint32_t id = visit(std::any_cast<Ref<LoxArray>>(value));
+        contents.push_back(VALUE_OBJECT);
+        loxc::putU32(contents, id);
+    }
+    else if (value.type() == typeid(Ref<LoxMap>))
+    {
+        uint32_t id = visit(std::any_cast<Ref<LoxMap>>(value));
+        contents.push_back(VALUE_OBJECT);
+        loxc::putU32(contents, id);
+    }
+    else if (std::string name = nativeName(value); !name.empty())
+    {
+        // Natives live in the executable, not the image; they are looked
+        // up by name in the loading interpreter.
+        contents.push_back(VALUE_NATIVE);
+        putString(contents, name);
+    }
+    else
+    {
+        throw loxc::CacheError{"value can't be stored in an image"};
+    }
+}
+
+bool HeapImage::write(const std::string &path, const Interpreter &interpreter)
+{
+    AstWriter writer;
+    ast = &writer;
+
+    try
+    {
+        // Functions can come from any program the interpreter has run,
+        // including the prelude of an image it was started from, so the
+        // image keeps all of them as one.
+        std::vector<std::shared_ptr<Stmt>> prelude;
+        for (const std::shared_ptr<const Program> &program :
+             interpreter.retained())
+        {
+            prelude.insert(prelude.end(), program->statements.begin(),
+                           program->statements.end());
+        }
+        writer.write(prelude);
+
+        visit(interpreter.globals);
+
+        // Filling in bindings can discover further objects, so keep going
+        // until the lists stop growing.
+        uint32_t records = 0;
+        size_t nextEnvironment = 0;
+        size_t nextInstance = 0;
+        size_t nextArray = 0;
+        size_t nextMap = 0;
+        while (nextEnvironment < environments.size() ||
+               nextInstance < instances.size() ||
+               nextArray < arrays.size() || nextMap < maps.size())
+        {
+            if (nextEnvironment < environments.size())
+            {
+                Ref<Environment> environment =
+                    environments[nextEnvironment++];
+                contents.push_back(ENVIRONMENT);
+                loxc::putU32(contents, ids.at(environment.get()));
+                loxc::putU32(contents, environment->values.size());
+                for (const auto &[name, value] : environment->values)
+                {
+                    putString(contents, name);
+                    writeValue(value);
+                }
+            }
+            else if (nextInstance < instances.size())
+            {
+                Ref<LoxInstance> instance =
+                    instances[nextInstance++];
+                contents.push_back(INSTANCE);
+                loxc::putU32(contents, ids.at(instance.get()));
+                loxc::putU32(contents, instance->fields.size());
+                for (const auto &[name, value] : instance->fields)
+                {
+                    putString(contents, name);
+                    writeValue(value);
+                }
+            }
+            else if (nextArray < arrays.size())
+            {
+                Ref<LoxArray> array = arrays[nextArray++];
+                contents.push_back(ARRAY);
+                loxc::putU32(contents, ids.at(array.get()));
+                loxc::putU32(contents, array->size());
+                for (size_t i = 0; i < array->size(); ++i)
+                    writeValue(array->at(i));
+            }
+            else
+            {
+                Ref<LoxMap> map = maps[nextMap++];
+                contents.push_back(MAP);
+                loxc::putU32(contents, ids.at(map.get()));
+                loxc::putU32(contents, map->size());
+                map->forEach([&](const std::any &key, const std::any &value)
+                             {
+                                 writeValue(key);
+                                 writeValue(value);
+                             });
+            }
+            ++records;
+        }
+
+        std::string payload = writer.bytes();
+        loxc::putU32(payload, ids.size());
+        payload += objects;
+        loxc::putU32(payload, records);
+        payload += contents;
+
+        std::string header{MAGIC, 4};
+        loxc::putU32(header, VERSION);
+        loxc::putU64(header, payload.size());
+        loxc::putU64(header, loxc::hash(payload));
+
+        return loxc::writeFile(path, header, payload);
+    }
+    catch (const loxc::CacheError &)
+    {
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------- loading
+
+template <class T>
+Ref<T> HeapImage::object(uint32_t id) const
+{
+    if (id >= heap.size() ||
+        heap[id].type() != typeid(Ref<T>))
+    {
+        throw loxc::CacheError{"bad object reference"};
+    }
+    return std::any_cast<Ref<T>>(heap[id]);
+}
+
+std::any HeapImage::readValue(AstReader &reader)
+{
+    switch (reader.readU8())
+    {
+    case VALUE_NIL:
+        return nullptr;
+    case VALUE_FALSE:
+        return false;
+    case VALUE_TRUE:
+        return true;
+    case VALUE_NUMBER:
+    {
+        uint64_t bits = reader.readU64();
+        double number;
+        std::memcpy(&number, &bits, sizeof number);
+        return number;
+    }
+    case VALUE_STRING:
+        return reader.readString();
+    case VALUE_OBJECT:
+    {
+        uint32_t id = reader.readU32();
+        if (id >= heap.size() || heap[id].type() ==
+                                     typeid(Ref<Environment>))
+        {
+            throw loxc::CacheError{"bad object reference"};
+        }
+        return heap[id];
+    }
+    case VALUE_NATIVE:
+    {
+        // Natives are taken from the loading interpreter's own globals.
+        Ref<Environment> globals = object<Environment>(0);
+        auto elem = globals->values.find(reader.readString());
+        if (elem == globals->values.end() || nativeName(elem->second).empty())
+            throw loxc::CacheError{"unknown native"};
+        return elem->second;
+    }
+    default:
+        throw loxc::CacheError{"bad value tag"};
+    }
+}
+
+bool HeapImage::load(const std::string &path, Interpreter &interpreter)
+{
+    loxc::MappedFile file{path};
+    if (file.size() < HEADER_SIZE)
+        return false;
+
+    const char *data = file.data();
+    const char *end = data + file.size();
+    const char *payload = data + HEADER_SIZE;
+    if (std::memcmp(data, MAGIC, 4) != 0 ||
+        loxc::getU32(data + 4) != VERSION ||
+        loxc::getU64(data + 8) != file.size() - HEADER_SIZE ||
+        loxc::getU64(data + 16) !=
+            loxc::hash(std::string_view{payload, file.size() - HEADER_SIZE}))
+    {
+        return false;
+    }
+
+    heap.clear();
+    std::vector<std::pair<std::string, std::any>> globals;
+    std::vector<std::shared_ptr<Stmt>> prelude;
+
+    try
+    {
+        AstReader reader{payload, end};
+        prelude = reader.read();
+
+        uint32_t count = reader.readU32();
+        reader.need(count);
+        heap.reserve(count);
+        for (uint32_t id = 0; id < count; ++id)
+        {
+            switch (reader.readU8())
+            {
+            case ENVIRONMENT:
+            {
+                uint32_t enclosing = reader.readU32();
+                if (id == 0)
+                {
+                    // The image's globals become the interpreter's own.
+                    if (enclosing != NO_OBJECT)
+                        throw loxc::CacheError{"globals must come first"};
+                    heap.emplace_back(interpreter.globals);
+                }
+                else if (enclosing == NO_OBJECT)
+                {
+                    heap.emplace_back(makeRef<Environment>());
+                }
+                else
+                {
+                    heap.emplace_back(makeRef<Environment>(
+                        object<Environment>(enclosing)));
+                }
+                break;
+            }
+            case FUNCTION:
+            {
+                const FunctionStmt *declaration =
+                    reader.function(reader.readU32()).get();
+                Ref<Environment> closure =
+                    object<Environment>(reader.readU32());
+                bool isInitializer = reader.readU8() != 0;
+                heap.emplace_back(makeRef<LoxFunction>(
+                    declaration, closure, isInitializer));
+                break;
+            }
+            case CLASS:
+            {
+                std::string name = reader.readString();
+                std::map<std::string, Ref<LoxFunction>> methods;
+                for (uint32_t i = reader.readU32(); i > 0; --i)
+                {
+                    std::string method = reader.readString();
+                    methods[method] = object<LoxFunction>(reader.readU32());
+                }
+                heap.emplace_back(makeRef<LoxClass>(
+                    std::move(name), std::move(methods)));
+                break;
+            }
+            case INSTANCE:
+                heap.emplace_back(makeRef<LoxInstance>(
+                    object<LoxClass>(reader.readU32())));
+                break;
+            case ARRAY:
+                heap.emplace_back(makeRef<LoxArray>());
+                break;
+            case MAP:
+                heap.emplace_back(makeRef<LoxMap>());
+                break;
+            default:
+                throw loxc::CacheError{"bad object kind"};
+            }
+        }
+
+        for (uint32_t records = reader.readU32(); records > 0; --records)
+        {
+            uint8_t kind = reader.readU8();
+            uint32_t id = reader.readU32();
+            uint32_t bindings = reader.readU32();
+
+            if (kind == ENVIRONMENT && id == 0)
+            {
+                for (; bindings > 0; --bindings)
+                {
+                    std::string name = reader.readString();
+                    globals.emplace_back(std::move(name), readValue(reader));
+                }
+            }
+            else if (kind == ENVIRONMENT)
+            {
+                Ref<Environment> environment =
+                    object<Environment>(id);
+                for (; bindings > 0; --bindings)
+                {
+                    std::string name = reader.readString();
+                    environment->values[name] = readValue(reader);
+                }
+            }
+            else if (kind == INSTANCE)
+            {
+                Ref<LoxInstance> instance = object<LoxInstance>(id);
+                for (; bindings > 0; --bindings)
+                {
+                    std::string name = reader.readString();
+                    instance->fields[name] = readValue(reader);
+                }
+            }
+            else if (kind == ARRAY)
+            {
+                Ref<LoxArray> array = object<LoxArray>(id);
+                for (; bindings > 0; --bindings)
+                    array->push(readValue(reader));
+            }
+            else if (kind == MAP)
+            {
+                Ref<LoxMap> map = object<LoxMap>(id);
+                for (; bindings > 0; --bindings)
+                {
+                    std::any key = readValue(reader);
+                    if (!LoxMap::isKey(key))
+                        throw loxc::CacheError{"bad map key"};
+                    map->store(key, readValue(reader));
+                }
+            }
+            else
+            {
+                throw loxc::CacheError{"bad contents record"};
+            }
+        }
+
+        if (reader.position() != end)
+            throw loxc::CacheError{"trailing bytes"};
+    }
+    catch (const loxc::CacheError &)
+    {
+        heap.clear();
+        return false;
+    }
+
+    // The restored functions point into the prelude's AST.
+    interpreter.retain(std::make_shared<const Program>(std::move(prelude)));
+    for (auto &[name, value] : globals)
+        interpreter.globals->define(name, std::move(value));
+
+    heap.clear();
+    return true;
+}
@@ -0,0 +1,413 @@
+#include "HeapSnapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include "Environment.h"
+#include "Interpreter.h"
+#include "LoxArray.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "LoxMap.h"
+#include "NativeMethod.h"
+#include "NumberFormat.h"
+#include "Stmt.h"
+
+namespace
+{
+    // A std::map node: the pair plus the tree's links and colour.
+    constexpr uint64_t MAP_NODE =
+        sizeof(std::pair<const std::string, std::any>) + 32;
+
+    // Heap bytes of a string beyond the object itself; short strings
+    // live inside it.
+    uint64_t stringBytes(const std::string &text)
+    {
+        return text.capacity() > 15 ? text.capacity() + 1 : 0;
+    }
+
+    uint64_t fieldsBytes(const std::map<std::string, std::any> &fields)
+    {
+        uint64_t bytes = fields.size() * MAP_NODE;
+        for (const auto &[name, value] : fields)
+            bytes += stringBytes(name);
+        return bytes;
+    }
+
+    std::string keyName(const std::any &key)
+    {
+        if (key.type() == typeid(std::string))
+            return std::any_cast<const std::string &>(key);
+        char text[numbers::MAX_LENGTH];
+        return std::string{text, numbers::format(std::any_cast<double>(key), text)};
+    }
+
+    void escape(std::FILE *file, const std::string &text)
+    {
+        std::fputc('"', file);
+        for (unsigned char c : text)
+        {
+            if (c == '"' || c == '\\')
+                std::fprintf(file, "\\%c", c);
+            else if (c < 0x20)
+                std::fprintf(file, "\\u%04x", c);
+            else
+                std::fputc(c, file);
+        }
+        std::fputc('"', file);
+    }
+
+    void requestSnapshot(int)
+    {
+        HeapSnapshot::requested = 1;
+    }
+}
+
+void HeapSnapshot::installSignalHandler()
+{
+    struct sigaction action{};
+    action.sa_handler = requestSnapshot;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR2, &action, nullptr);
+}
+
+HeapSnapshot::HeapSnapshot(Interpreter &interpreter)
+{
+    nodes.push_back(Node{"root", "", 0});
+    edge(0, interpreter.globals.get(), "globals", "globals");
+    edge(0, interpreter.environment.get(), "current", "current");
+    for (size_t i = interpreter.frames.size(); i-- > 0;)
+    {
+        const CallFrame &frame = interpreter.frames[i];
+        std::string name = "caller of " + frame.function->name.lexeme;
+        edge(0, frame.caller, name, name);
+    }
+
+    // Breadth first, so long chains of objects don't recurse.  expand()
+    // adds to pending, so it gets a copy.
+    for (size_t next = 0; next < pending.size(); ++next)
+        expand(pending[next]);
+    pending.clear();
+
+    computeRetained();
+}
+
+uint32_t HeapSnapshot::add(Kind kind, const void *object, const char *type,
+                           std::string name)
+{
+    auto [elem, added] = ids.emplace(object, nodes.size());
+    if (added)
+    {
+        nodes.push_back(Node{type, std::move(name), 0});
+        pending.push_back(Pending{elem->second, kind, object});
+    }
+    return elem->second;
+}
+
+void HeapSnapshot::edge(uint32_t from, Environment *environment,
+                        std::string name, std::string owner)
+{
+    if (environment == nullptr)
+        return;
+    uint32_t to = add(ENVIRONMENT, environment, "environment",
+                      std::move(owner));
+    edges.push_back(Edge{from, to, std::move(name)});
+}
+
+uint64_t HeapSnapshot::edge(uint32_t from, const std::any &value,
+                            std::string name)
+{
+    const std::type_info &type = value.type();
+    uint32_t to;
+    if (type == typeid(std::string))
+    {
+        return stringBytes(std::any_cast<const std::string &>(value));
+    }
+    else if (type == typeid(Ref<LoxFunction>))
+    {
+        LoxFunction *function = std::any_cast<const Ref<LoxFunction> &>(value).get();
+        to = add(FUNCTION, function, "function",
+                 function->declaration->name.lexeme);
+    }
+    else if (type == typeid(Ref<LoxClass>))
+    {
+        LoxClass *klass = std::any_cast<const Ref<LoxClass> &>(value).get();
+        to = add(CLASS, klass, "class", klass->name);
+    }
+    else if (type == typeid(Ref<LoxInstance>))
+    {
+        LoxInstance *instance = std::any_cast<const Ref<LoxInstance> &>(value).get();
+        to = add(INSTANCE, instance, "instance", instance->klass->name);
+    }
+    else if (type == typeid(Ref<LoxArray>))
+    {
+        to = add(ARRAY, std::any_cast<const Ref<LoxArray> &>(value).get(),
+                 "array", "");
+    }
+    else if (type == typeid(Ref<LoxMap>))
+    {
+        to = add(MAP, std::any_cast<const Ref<LoxMap> &>(value).get(), "map",
+                 "");
+    }
+    else if (type == typeid(Ref<ArrayMethod>))
+    {
+        ArrayMethod *method = std::any_cast<const Ref<ArrayMethod> &>(value).get();
+        to = add(ARRAY_METHOD, method, "native method", method->method->name);
+    }
+    else if (type == typeid(Ref<MapMethod>))
+    {
+        MapMethod *method = std::any_cast<const Ref<MapMethod> &>(value).get();
+        to = add(MAP_METHOD, method, "native method", method->method->name);
+    }
+    else
+    {
+        // Nil, booleans, numbers, natives, tasks, channels and coroutines.
+        return 0;
+    }
+    edges.push_back(Edge{from, to, std::move(name)});
+    return 0;
+}
+
+void HeapSnapshot::expand(Pending next)
+{
+    uint64_t size = 0;
+    switch (next.kind)
+    {
+    case ENVIRONMENT:
+    {
+        auto *environment = static_cast<const Environment *>(next.object);
+        size = sizeof(Environment) + fieldsBytes(environment->values);
+        for (const auto &[name, value] : environment->values)
+            size += edge(next.id, value, name);
+        edge(next.id, environment->enclosing.get(), "enclosing");
+        break;
+    }
+    case FUNCTION:
+    {
+        auto *function = static_cast<const LoxFunction *>(next.object);
+        size = sizeof(LoxFunction);
+        edge(next.id, function->closure.get(), "closure",
+             "closure of " + function->declaration->name.lexeme);
+        break;
+    }
+    case CLASS:
+    {
+        auto *klass = static_cast<const LoxClass *>(next.object);
+        size = sizeof(LoxClass) + stringBytes(klass->name) +
+               klass->methods.size() * MAP_NODE;
+        for (const auto &[name, method] : klass->methods)
+            edge(next.id, std::any{method}, name);
+        break;
+    }
+    case INSTANCE:
+    {
+        auto *instance = static_cast<const LoxInstance *>(next.object);
+        size = sizeof(LoxInstance) + fieldsBytes(instance->fields);
+        edge(next.id, std::any{instance->klass}, "class");
+        for (const auto &[name, value] : instance->fields)
+            size += edge(next.id, value, name);
+        break;
+    }
+    case ARRAY:
+    {
+        auto *array = static_cast<const LoxArray *>(next.object);
+        size = sizeof(LoxArray) + array->numbers.capacity() * sizeof(double) +
+               array->values.capacity() * sizeof(std::any);
+        for (size_t i = 0; i < array->values.size(); ++i)
+            size += edge(next.id, array->values[i], "[" + std::to_string(i) + "]");
+        break;
+    }
+    case MAP:
+    {
+        auto *map = static_cast<const LoxMap *>(next.object);
+        size = sizeof(LoxMap) + map->control.capacity() +
+               map->slots.capacity() * sizeof(uint32_t) +
+               map->entries.capacity() * sizeof(LoxMap::Entry);
+        map->forEach([&](const std::any &key, const std::any &value)
+                     {
+                         size += edge(next.id, key, "");
+                         size += edge(next.id, value, "{" + keyName(key) + "}");
+                     });
+        break;
+    }
+    case ARRAY_METHOD:
+    {
+        auto *method = static_cast<const ArrayMethod *>(next.object);
+        size = sizeof(ArrayMethod);
+        edge(next.id, std::any{method->receiver}, "receiver");
+        break;
+    }
+    case MAP_METHOD:
+    {
+        auto *method = static_cast<const MapMethod *>(next.object);
+        size = sizeof(MapMethod);
+        edge(next.id, std::any{method->receiver}, "receiver");
+        break;
+    }
+    }
+    nodes[next.id].size = size;
+}
+
+void HeapSnapshot::computeRetained()
+{
+    size_t count = nodes.size();
+    std::vector<std::vector<uint32_t>> successors(count), predecessors(count);
+    for (const Edge &edge : edges)
+    {
+        successors[edge.from].push_back(edge.to);
+        predecessors[edge.to].push_back(edge.from);
+    }
+
+    // Depth-first postorder from the root, without recursion.
+    const uint32_t NONE = 0xffffffff;
+    std::vector<uint32_t> postorder(count, NONE), order;
+    std::vector<uint8_t> seen(count, 0);
+    std::vector<std::pair<uint32_t, size_t>> stack{{0, 0}};
+    seen[0] = 1;
+    while (!stack.empty())
+    {
+        auto &[node, child] = stack.back();
+        if (child < successors[node].size())
+        {
+            uint32_t next = successors[node][child++];
+            if (!seen[next])
+            {
+                seen[next] = 1;
+                stack.emplace_back(next, 0);
+            }
+            continue;
+        }
+        postorder[node] = order.size();
+        order.push_back(node);
+        stack.pop_back();
+    }
+
+    std::vector<uint32_t> dominator(count, NONE);
+    dominator[0] = 0;
+    auto intersect = [&](uint32_t a, uint32_t b)
+    {
+        while (a != b)
+        {
+            while (postorder[a] < postorder[b])
+                a = dominator[a];
+            while (postorder[b] < postorder[a])
+                b = dominator[b];
+        }
+        return a;
+    };
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        // Reverse postorder, skipping the root (last in postorder).
+        for (size_t i = order.size() - 1; i-- > 0;)
+        {
+            uint32_t node = order[i];
+            uint32_t idom = NONE;
+            for (uint32_t predecessor : predecessors[node])
+            {
+                if (dominator[predecessor] == NONE)
+                    continue;
+                idom = idom == NONE ? predecessor : intersect(predecessor, idom);
+            }
+            if (dominator[node] != idom)
+            {
+                dominator[node] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    // Everything a node dominates comes before it in postorder.
+    for (uint32_t node : order)
+    {
+        nodes[node].retained += nodes[node].size;
+        if (node != 0)
+            nodes[dominator[node]].retained += nodes[node].retained;
+    }
+}
+
+bool HeapSnapshot::write(const std::string &path) const
+{
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "{\"nodes\": [\n");
+    for (size_t id = 0; id < nodes.size(); ++id)
+    {
+        const Node &node = nodes[id];
+        std::fprintf(file, "{\"id\": %zu, \"type\": \"%s\", \"name\": ", id,
+                     node.type);
+        escape(file, node.name);
+        std::fprintf(file, ", \"size\": %llu, \"retained\": %llu}%s\n",
+                     static_cast<unsigned long long>(node.size),
+                     static_cast<unsigned long long>(node.retained),
+                     id + 1 < nodes.size() ? "," : "");
+    }
+    std::fprintf(file, "],\n\"edges\": [\n");
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        const Edge &edge = edges[i];
+        std::fprintf(file, "{\"from\": %u, \"to\": %u, \"name\": ", edge.from,
+                     edge.to);
+        escape(file, edge.name);
+        std::fprintf(file, "}%s\n", i + 1 < edges.size() ? "," : "");
+    }
+    std::fprintf(file, "]}\n");
+    return std::fclose(file) == 0;
+}
+
+void HeapSnapshot::summarize(std::ostream &out, size_t top) const
+{
+    char line[160];
+    std::snprintf(line, sizeof line, "Heap: %zu objects, %llu bytes\n",
+                  nodes.size() - 1,
+                  static_cast<unsigned long long>(nodes[0].retained));
+    out << line;
+
+    std::vector<uint32_t> largest;
+    for (uint32_t id = 1; id < nodes.size(); ++id)
+        largest.push_back(id);
+    std::stable_sort(largest.begin(), largest.end(), [&](uint32_t a, uint32_t b)
+                     { return nodes[a].retained > nodes[b].retained; });
+    if (largest.size() > top)
+        largest.resize(top);
+
+    std::snprintf(line, sizeof line, "%12s %10s  %-14s %s\n", "retained",
+                  "self", "type", "name");
+    out << line;
+    for (uint32_t id : largest)
+    {
+        const Node &node = nodes[id];
+        std::snprintf(line, sizeof line, "%12llu %10llu  %-14s %s\n",
+                      static_cast<unsigned long long>(node.retained),
+                      static_cast<unsigned long long>(node.size), node.type,
+                      node.name.c_str());
+        out << line;
+    }
+}
+
+std::string HeapSnapshot::take(Interpreter &interpreter, std::string path)
+{
+    static std::atomic<int> taken{0};
+    if (path.empty())
+    {
+        path = "heap-" + std::to_string(getpid()) + "-" +
+               std::to_string(++taken) + ".json";
+    }
+
+    HeapSnapshot snapshot{interpreter};
+    interpreter.output().flush();
+    if (!snapshot.write(path))
+    {
+        std::cerr << "Failed to write heap snapshot " << path << "\n";
+        return "";
+    }
+    std::cerr << "Heap snapshot written to " << path << "\n";
+    snapshot.summarize(std::cerr, 20);
+    return path;
+}
@@ -1,13 +1,57 @@
 #include "Interpreter.h"
+#include <algorithm> // std::find
+#include <cmath>     // std::floor
 #include "RuntimeError.h"
+#include "Allocations.h"
+#include "Coverage.h"
+#include "EventLoop.h"
+#include "HeapSnapshot.h"
+#include "LoxArray.h"
 #include "LoxClass.h"
+#include "LoxMap.h"
+#include "NumberFormat.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "Task.h"
+#include "Trace.h"
 
-Interpreter::Interpreter()
+Interpreter::Interpreter(std::ostream &out, std::ostream &err)
+    : errors{err}, stream{std::make_unique<StreamSink>(out)}, out{*stream}
 {
-    globals->define("clock", std::shared_ptr<NativeClock>{});
+    defineNatives(*globals);
 }
 
-std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
+Interpreter::Interpreter(OutputSink &out, std::ostream &err)
+    : errors{err}, out{out}
+{
+    defineNatives(*globals);
+}
+
+Interpreter::~Interpreter()
+{
+    out.flush();
+    tasks::waitAll(*this);
+}
+
+EventLoop &Interpreter::events()
+{
+    if (loop == nullptr)
+        loop = std::make_unique<EventLoop>(*this);
+    return *loop;
+}
+
+void Interpreter::resetEventLoop()
+{
+    loop.reset();
+}
+
+void Interpreter::runEventLoop()
+{
+    if (loop != nullptr)
+        loop->run();
+}
+
+std::any Interpreter::visitBinaryExpr(BinaryExpr *expr)
 {
     std::any left = evaluate(expr->left);
     std::any right = evaluate(expr->right);
@@ -38,8 +82,12 @@ std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
         if (left.type() == typeid(std::string) &&
             right.type() == typeid(std::string))
         {
-            return std::any_cast<std::string>(left) +
-                   std::any_cast<std::string>(right);
+            std::string result = std::any_cast<std::string>(left) +
+                                 std::any_cast<std::string>(right);
+            if (allocations::enabled)
+                allocations::allocated(allocations::STRING, nullptr,
+                                       result.capacity() + 1);
+            return result;
         }
         throw RuntimeError{expr->op,
                            "Operands must be two numbers or two strings."};
@@ -73,15 +121,15 @@ std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
     return nullptr;
 }
 
-std::any Interpreter::visitGroupingExpr(std::shared_ptr<GroupingExpr> expr)
+std::any Interpreter::visitGroupingExpr(GroupingExpr *expr)
 {
     return evaluate(expr->expression);
 }
-std::any Interpreter::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
+std::any Interpreter::visitLiteralExpr(LiteralExpr *expr)
 {
     return expr->value;
 }
-std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
+std::any Interpreter::visitUnaryExpr(UnaryExpr *expr)
 {
     std::any right = evaluate(expr->right);
     switch (expr->op.type)
@@ -99,7 +147,7 @@ std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
     }
 }
 
-std::any Interpreter::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
+std::any Interpreter::visitLogicalExpr(LogicalExpr *expr)
 {
     std::any left = evaluate(expr->left);
 
@@ -114,46 +162,118 @@ std::any Interpreter::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
             return left;
     }
 
+    if (coverage::enabled)
+        coverage::taken(expr);
     return evaluate(expr->right);
 }
 
-std::any Interpreter::visitCallExpr(std::shared_ptr<CallExpr> expr)
+std::any Interpreter::visitCallExpr(CallExpr *expr)
 {
     std::any callee = evaluate(expr->callee);
 
     std::vector<std::any> arguments;
 
-    for (std::shared_ptr<Expr> argument : expr->arguments)
+    for (const std::shared_ptr<Expr> &argument : expr->arguments)
     {
         arguments.push_back(evaluate(argument));
     }
 
+    // What the call allocates is the call's, not its last argument's.
+    if (allocations::enabled)
+    {
+        allocations::site = expr;
+        if (!arguments.empty())
+            allocations::allocated(allocations::ARGUMENTS, nullptr,
+                                   arguments.capacity() * sizeof(std::any));
+    }
+
+    return call(expr->paren, callee, std::move(arguments));
+}
+
+std::any Interpreter::call(const Token &paren, const std::any &callee,
+                           std::vector<std::any> arguments)
+{
+    stats::add(stats::CALLS);
+
+    auto checkArity = [&](int arity, int optional)
+    {
+        int count = static_cast<int>(arguments.size());
+        if (count < arity || count > arity + optional)
+        {
+            std::string expected = std::to_string(arity);
+            if (optional > 0)
+                expected += " to " + std::to_string(arity + optional);
+            throw RuntimeError{paren, "Expected " + expected +
+                                          " arguments but got " +
+                                          std::to_string(count) + "."};
+        }
+    };
+
+    if (callee.type() == typeid(const Native *))
+    {
+        const Native *native = std::any_cast<const Native *>(callee);
+        checkArity(native->arity, native->optional);
+        nativeCall = &paren;
+        trace::Span span{trace::NATIVE, native->name};
+        try
+        {
+            std::any result = native->function(*this, arguments);
+            if (allocations::enabled && result.type() == typeid(std::string))
+            {
+                allocations::allocated(
+                    allocations::STRING, nullptr,
+                    std::any_cast<std::string &>(result).capacity() + 1);
+            }
+            return result;
+        }
+        catch (const NativeError &error)
+        {
+            throw RuntimeError{paren, error.what()};
+        }
+    }
+
     // Pointers in a std::any wrapper must be unwrapped before they
     // can be cast.
-    std::shared_ptr<LoxCallable> function;
+    Ref<LoxCallable> function;
 
-    if (callee.type() == typeid(std::shared_ptr<LoxFunction>))
+    if (callee.type() == typeid(Ref<LoxFunction>))
     {
-        function = std::any_cast<std::shared_ptr<LoxFunction>>(callee);
+        function = std::any_cast<Ref<LoxFunction>>(callee);
+    }
+    else if (callee.type() == typeid(Ref<LoxClass>))
+    {
+        function = std::any_cast<Ref<LoxClass>>(callee);
+    }
+    else if (callee.type() == typeid(Ref<ArrayMethod>))
+    {
+        function = std::any_cast<Ref<ArrayMethod>>(callee);
+    }
+    else if (callee.type() == typeid(Ref<MapMethod>))
+    {
+        function = std::any_cast<Ref<MapMethod>>(callee);
     }
     else
     {
-        throw RuntimeError{expr->paren,
-                           "Can only call functions and classes."};
+        throw RuntimeError{paren, "Can only call functions and classes."};
     }
 
-    if (arguments.size() != function->arity())
+    checkArity(function->arity(), 0);
+    try
     {
-        throw RuntimeError{expr->paren, "Expected " +
-                                            std::to_string(function->arity()) + " arguments but got " +
-                                            std::to_string(arguments.size()) + "."};
+        return function->call(*this, std::move(arguments));
+    }
+    catch (const NativeError &error)
+    {
+        throw RuntimeError{paren, error.what()};
     }
-
-    return function->call(*this, std::move(arguments));
 }
 
-std::any Interpreter::evaluate(std::shared_ptr<Expr> expr)
+std::any Interpreter::evaluate(const std::shared_ptr<Expr> &expr)
 {
+    if (coverage::enabled)
+        coverage::hit(expr.get());
+    if (allocations::enabled)
+        allocations::site = expr.get();
     return expr->accept(*this);
 }
 
@@ -214,68 +334,159 @@ bool Interpreter::isEqual(const std::any &a, const std::any &b)
     return false;
 }
 
-void Interpreter::execute(std::shared_ptr<Stmt> statement)
+void Interpreter::execute(const std::shared_ptr<Stmt> &statement)
 {
+    if (profiler::pending != 0)
+        profiler::sample(frames);
+    if (HeapSnapshot::requested != 0)
+    {
+        HeapSnapshot::requested = 0;
+        HeapSnapshot::take(*this, "");
+    }
+    if (coverage::enabled)
+        coverage::hit(statement.get());
+    if (allocations::enabled)
+        allocations::site = statement.get();
     statement->accept(*this);
 }
 
-void Interpreter::interpret(std::vector<std::shared_ptr<Stmt>> statements)
+void Interpreter::interpret(const std::shared_ptr<const Program> &program)
 {
+    retain(program);
+    // Ticks from compiling it aren't Lox code's.
+    profiler::pending = 0;
+
     try
     {
         // std::any value = evaluate(expression);
         // std::cout << stringify(value) << "\n";
-        for (auto statement : statements)
+        for (const std::shared_ptr<Stmt> &statement : program->statements)
             execute(statement);
+        runEventLoop();
     }
-    catch (const std::exception &e)
+    catch (const RuntimeError &error)
     {
-        std::cerr << e.what() << '\n';
+        out.flush();
+        errors.runtimeError(error);
     }
+    out.flush();
+    tasks::waitAll(*this);
 }
 
 std::string Interpreter::stringify(const std::any &object)
+{
+    std::string text;
+    format(text, object);
+    return text;
+}
+
+void Interpreter::format(std::string &text, const std::any &object)
 {
     if (object.type() == typeid(nullptr))
-        return "nil";
+    {
+        text += "nil";
+    }
+    else if (object.type() == typeid(double))
+    {
+        char digits[numbers::MAX_LENGTH];
+        text.append(digits,
+                    numbers::format(std::any_cast<double>(object), digits));
+    }
+    else if (object.type() == typeid(std::string))
+    {
+        text += std::any_cast<const std::string &>(object);
+    }
+    else if (object.type() == typeid(bool))
+    {
+        text += std::any_cast<bool>(object) ? "true" : "false";
+    }
+    else if (object.type() == typeid(Ref<LoxFunction>))
+        text += std::any_cast<Ref<LoxFunction>>(object)->toString();
+    else if (object.type() == typeid(Ref<LoxClass>))
+        text += std::any_cast<Ref<LoxClass>>(object)->toString();
+    else if (object.type() == typeid(Ref<LoxInstance>))
+        text += std::any_cast<Ref<LoxInstance>>(object)->toString();
+    else if (object.type() == typeid(Ref<LoxArray>))
+        format(text, *std::any_cast<const Ref<LoxArray> &>(object));
+    else if (object.type() == typeid(Ref<LoxMap>))
+        format(text, *std::any_cast<const Ref<LoxMap> &>(object));
+    else if (object.type() == typeid(Ref<ArrayMethod>) ||
+             object.type() == typeid(Ref<MapMethod>) ||
+             object.type() == typeid(const Native *))
+        text += "<native fn>";
+    else if (object.type() == typeid(Ref<Coroutine>))
+        text += "<coroutine>";
+    else if (object.type() == typeid(std::shared_ptr<tasks::Task>))
+        text += "<task>";
+    else if (object.type() == typeid(std::shared_ptr<tasks::Channel>))
+        text += "<channel>";
+    else
+        text += "Error in stringify: object type not recognized.";
+}
+
+// Arrays and maps that contain themselves print as [...] or {...} the
+// second time round.
+static thread_local std::vector<const void *> printing;
 
-    if (object.type() == typeid(double))
+void Interpreter::format(std::string &text, LoxArray &array)
+{
+    if (std::find(printing.begin(), printing.end(), &array) != printing.end())
     {
-        std::string text = std::to_string(
-            std::any_cast<double>(object));
-        if (text[text.length() - 2] == '.' &&
-            text[text.length() - 1] == '0')
-        {
-            text = text.substr(0, text.length() - 2);
-        }
-        return text;
+        text += "[...]";
+        return;
     }
 
-    if (object.type() == typeid(std::string))
+    printing.push_back(&array);
+    text += '[';
+    for (size_t i = 0; i < array.size(); ++i)
     {
-        return std::any_cast<std::string>(object);
+        if (i > 0)
+            text += ", ";
+        format(text, array.at(i));
     }
-    if (object.type() == typeid(bool))
+    text += ']';
+    printing.pop_back();
+}
+
+void Interpreter::format(std::string &text, LoxMap &map)
+{
+    if (std::find(printing.begin(), printing.end(), &map) != printing.end())
     {
-        return std::any_cast<bool>(object) ? "true" : "false";
+        text += "{...}";
+        return;
     }
 
-    return "Error in stringify: object type not recognized.";
+    printing.push_back(&map);
+    text += '{';
+    bool first = true;
+    map.forEach([&](const std::any &key, const std::any &value)
+                {
+                    if (!first)
+                        text += ", ";
+                    first = false;
+                    format(text, key);
+                    text += ": ";
+                    format(text, value);
+                });
+    text += '}';
+    printing.pop_back();
 }
 
-std::any Interpreter::visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt)
+std::any Interpreter::visitExpressionStmt(ExpressionStmt *stmt)
 {
     evaluate(stmt->expression);
     return {};
 }
-std::any Interpreter::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
+std::any Interpreter::visitPrintStmt(PrintStmt *stmt)
 {
     std::any value = evaluate(stmt->expression);
-    std::cout << stringify(value) << "\n";
+    format(out.buffer(), value);
+    out.buffer() += '\n';
+    out.written();
     return {};
 }
 
-std::any Interpreter::visitVarStmt(std::shared_ptr<VarStmt> stmt)
+std::any Interpreter::visitVarStmt(VarStmt *stmt)
 {
     std::any value = nullptr;
     if (stmt->initializer != nullptr)
@@ -288,19 +499,17 @@ std::any Interpreter::visitVarStmt(std::shared_ptr<VarStmt> stmt)
     return {};
 }
 
-std::any Interpreter::visitVariableExpr(std::shared_ptr<VariableExpr> expr)
+std::any Interpreter::visitVariableExpr(VariableExpr *expr)
 {
     return lookUpVariable(expr->name, expr);
 }
 
 std::any Interpreter::lookUpVariable(const Token &name,
-                                     std::shared_ptr<Expr> expr)
+                                     Expr *expr)
 {
-    auto elem = locals.find(expr);
-    if (elem != locals.end())
+    if (expr->depth >= 0)
     {
-        int distance = elem->second;
-        return environment->getAt(distance, name.lexeme);
+        return environment->getAt(expr->depth, name.lexeme);
     }
     else
     {
@@ -308,15 +517,13 @@ std::any Interpreter::lookUpVariable(const Token &name,
     }
 }
 
-std::any Interpreter::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
+std::any Interpreter::visitAssignExpr(AssignExpr *expr)
 {
     std::any value = evaluate(expr->value);
 
-    auto elem = locals.find(expr);
-    if (elem != locals.end())
+    if (expr->depth >= 0)
     {
-        int distance = elem->second;
-        environment->assignAt(distance, expr->name, value);
+        environment->assignAt(expr->depth, expr->name, value);
     }
     else
     {
@@ -326,18 +533,18 @@ std::any Interpreter::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
     return value;
 }
 
-std::any Interpreter::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
+std::any Interpreter::visitBlockStmt(BlockStmt *stmt)
 {
     executeBlock(stmt->statements,
-                 std::make_shared<Environment>(environment));
+                 makeRef<Environment>(environment));
     return {};
 }
 
 void Interpreter::executeBlock(
     const std::vector<std::shared_ptr<Stmt>> &statements,
-    std::shared_ptr<Environment> environment)
+    Ref<Environment> environment)
 {
-    std::shared_ptr<Environment> previous = this->environment;
+    Ref<Environment> previous = this->environment;
     try
     {
         this->environment = environment;
@@ -356,10 +563,12 @@ void Interpreter::executeBlock(
     this->environment = previous;
 }
 
-std::any Interpreter::visitIfStmt(std::shared_ptr<IfStmt> stmt)
+std::any Interpreter::visitIfStmt(IfStmt *stmt)
 {
     if (isTruthy(evaluate(stmt->condition)))
     {
+        if (coverage::enabled)
+            coverage::taken(stmt);
         execute(stmt->thenBranch);
     }
     else if (stmt->elseBranch != nullptr)
@@ -369,23 +578,25 @@ std::any Interpreter::visitIfStmt(std::shared_ptr<IfStmt> stmt)
     return {};
 }
 
-std::any Interpreter::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
+std::any Interpreter::visitWhileStmt(WhileStmt *stmt)
 {
     while (isTruthy(evaluate(stmt->condition)))
     {
+        if (coverage::enabled)
+            coverage::taken(stmt);
         execute(stmt->body);
     }
     return {};
 }
 
-std::any Interpreter::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
+std::any Interpreter::visitFunctionStmt(FunctionStmt *stmt)
 {
-    auto function = std::make_shared<LoxFunction>(stmt, environment,false);
+    auto function = makeRef<LoxFunction>(stmt, environment,false);
     environment->define(stmt->name.lexeme, function);
     return {};
 }
 
-std::any Interpreter::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
+std::any Interpreter::visitReturnStmt(ReturnStmt *stmt)
 {
     std::any value = nullptr;
     if (stmt->value != nullptr)
@@ -394,48 +605,56 @@ std::any Interpreter::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
     throw LoxReturn{value};
 }
 
-void Interpreter::resolve(std::shared_ptr<Expr> expr, int depth)
+void Interpreter::retain(std::shared_ptr<const Program> program)
 {
-    locals[expr] = depth;
+    if (std::find(programs.begin(), programs.end(), program) ==
+        programs.end())
+    {
+        programs.push_back(std::move(program));
+    }
 }
 
-std::any Interpreter::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
+std::any Interpreter::visitClassStmt(ClassStmt *stmt)
 {
     environment->define(stmt->name.lexeme, nullptr);
 
-    std::map<std::string, std::shared_ptr<LoxFunction>> methods;
+    std::map<std::string, Ref<LoxFunction>> methods;
 
-    for (std::shared_ptr<FunctionStmt> method : stmt->methods)
+    for (const std::shared_ptr<FunctionStmt> &method : stmt->methods)
     {
-        auto function = std::make_shared<LoxFunction>(method,
+        auto function = makeRef<LoxFunction>(method.get(),
                                                       // environment);
                                                       environment, method->name.lexeme == "init");
         methods[method->name.lexeme] = function;
     }
 
-    auto klass = std::make_shared<LoxClass>(stmt->name.lexeme, methods);
+    auto klass = makeRef<LoxClass>(stmt->name.lexeme, methods);
     
     environment->assign(stmt->name, klass);
     return {};
 }
 
-std::any Interpreter::visitGetExpr(std::shared_ptr<GetExpr> expr)
+std::any Interpreter::visitGetExpr(GetExpr *expr)
 {
     std::any object = evaluate(expr->object);
-    if (object.type() == typeid(std::shared_ptr<LoxInstance>))
+    if (object.type() == typeid(Ref<LoxInstance>))
     {
-        return std::any_cast<std::shared_ptr<LoxInstance>>(object)->get(expr->name);
+        return std::any_cast<Ref<LoxInstance>>(object)->get(expr->name);
     }
+    if (object.type() == typeid(Ref<LoxArray>))
+        return std::any_cast<const Ref<LoxArray> &>(object)->get(expr->name);
+    if (object.type() == typeid(Ref<LoxMap>))
+        return std::any_cast<const Ref<LoxMap> &>(object)->get(expr->name);
 
     throw RuntimeError(expr->name,
                        "Only instances have properties.");
 }
 
-std::any Interpreter::visitSetExpr(std::shared_ptr<SetExpr> expr)
+std::any Interpreter::visitSetExpr(SetExpr *expr)
 {
     std::any object = evaluate(expr->object);
 
-    if (object.type() != typeid(std::shared_ptr<LoxInstance>))
+    if (object.type() != typeid(Ref<LoxInstance>))
     {
         throw RuntimeError(expr->name,
                            "Only instances have fields.");
@@ -444,12 +663,70 @@ std::any Interpreter::visitSetExpr(std::shared_ptr<SetExpr> expr)
     std::any value = evaluate(expr->value);
 
     std::any_cast<
-        std::shared_ptr<LoxInstance>>(object)
+        Ref<LoxInstance>>(object)
         ->set(expr->name, value);
     return value;
 }
 
-std::any Interpreter::visitThisExpr(std::shared_ptr<ThisExpr> expr)
+LoxArray &Interpreter::checkIndex(const Token &bracket, const std::any &object,
+                                  const std::any &index, size_t &position)
+{
+    if (object.type() != typeid(Ref<LoxArray>))
+        throw RuntimeError{bracket, "Only arrays and maps can be indexed."};
+    if (index.type() != typeid(double))
+        throw RuntimeError{bracket, "Array index must be a number."};
+
+    LoxArray &array = *std::any_cast<const Ref<LoxArray> &>(object);
+    double number = std::any_cast<double>(index);
+    if (number < 0 || number >= static_cast<double>(array.size()))
+        throw RuntimeError{bracket, "Array index out of bounds."};
+    // NaN gets here too; only cast once it's known to be a valid index.
+    if (std::floor(number) != number)
+        throw RuntimeError{bracket, "Array index must be an integer."};
+    position = static_cast<size_t>(number);
+    return array;
+}
+
+LoxMap *Interpreter::checkKey(const Token &bracket, const std::any &object,
+                              const std::any &key)
+{
+    if (object.type() != typeid(Ref<LoxMap>))
+        return nullptr;
+    if (!LoxMap::isKey(key))
+        throw RuntimeError{bracket, "Map keys must be strings or numbers."};
+    return std::any_cast<const Ref<LoxMap> &>(object).get();
+}
+
+std::any Interpreter::visitIndexExpr(IndexExpr *expr)
+{
+    std::any object = evaluate(expr->object);
+    std::any index = evaluate(expr->index);
+
+    if (LoxMap *map = checkKey(expr->bracket, object, index))
+        return map->at(index);
+
+    size_t position;
+    return checkIndex(expr->bracket, object, index, position).at(position);
+}
+
+std::any Interpreter::visitIndexSetExpr(IndexSetExpr *expr)
+{
+    std::any object = evaluate(expr->object);
+    std::any index = evaluate(expr->index);
+    std::any value = evaluate(expr->value);
+
+    if (LoxMap *map = checkKey(expr->bracket, object, index))
+    {
+        map->store(index, value);
+        return value;
+    }
+
+    size_t position;
+    checkIndex(expr->bracket, object, index, position).store(position, value);
+    return value;
+}
+
+std::any Interpreter::visitThisExpr(ThisExpr *expr)
 {
     return lookUpVariable(expr->keyword, expr);
 }
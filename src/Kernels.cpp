@@ -0,0 +1,155 @@
+#include "Kernels.h"
+#include <cstring> // std::memcpy
+
+namespace
+{
+    // GCC/Clang vector extension: lowers to SSE2 on x86-64 and NEON on
+    // AArch64, and to scalar code anywhere else.
+    typedef double v2d __attribute__((vector_size(16)));
+    constexpr size_t LANES = 2;
+
+    v2d load(const double *p)
+    {
+        v2d v;
+        std::memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    void store(double *p, v2d v)
+    {
+        std::memcpy(p, &v, sizeof v);
+    }
+
+    double horizontal(v2d v)
+    {
+        return v[0] + v[1];
+    }
+}
+
+double kernels::sum(const double *a, size_t n)
+{
+    v2d s0 = {0, 0}, s1 = {0, 0}, s2 = {0, 0}, s3 = {0, 0};
+    size_t i = 0;
+    for (; i + 4 * LANES <= n; i += 4 * LANES)
+    {
+        s0 += load(a + i);
+        s1 += load(a + i + LANES);
+        s2 += load(a + i + 2 * LANES);
+        s3 += load(a + i + 3 * LANES);
+    }
+    double total = horizontal((s0 + s1) + (s2 + s3));
+    for (; i < n; ++i)
+        total += a[i];
+    return total;
+}
+
+double kernels::dot(const double *a, const double *b, size_t n)
+{
+    v2d s0 = {0, 0}, s1 = {0, 0}, s2 = {0, 0}, s3 = {0, 0};
+    size_t i = 0;
+    for (; i + 4 * LANES <= n; i += 4 * LANES)
+    {
+        s0 += load(a + i) * load(b + i);
+        s1 += load(a + i + LANES) * load(b + i + LANES);
+        s2 += load(a + i + 2 * LANES) * load(b + i + 2 * LANES);
+        s3 += load(a + i + 3 * LANES) * load(b + i + 3 * LANES);
+    }
+    double total = horizontal((s0 + s1) + (s2 + s3));
+    for (; i < n; ++i)
+        total += a[i] * b[i];
+    return total;
+}
+
+// A NaN is taken like a new minimum (or maximum), and once the
+// accumulator holds one nothing compares past it, so it sticks.
+double kernels::min(const double *a, size_t n)
+{
+    double result = a[0];
+    size_t i = 0;
+    if (n >= 2 * LANES)
+    {
+        v2d m0 = load(a), m1 = load(a + LANES);
+        for (i = 2 * LANES; i + 2 * LANES <= n; i += 2 * LANES)
+        {
+            v2d x0 = load(a + i), x1 = load(a + i + LANES);
+            m0 = (x0 < m0) | (x0 != x0) ? x0 : m0;
+            m1 = (x1 < m1) | (x1 != x1) ? x1 : m1;
+        }
+        m0 = (m1 < m0) | (m1 != m1) ? m1 : m0;
+        result = m0[1] < m0[0] || m0[1] != m0[1] ? m0[1] : m0[0];
+    }
+    for (; i < n; ++i)
+        result = a[i] < result || a[i] != a[i] ? a[i] : result;
+    return result;
+}
+
+double kernels::max(const double *a, size_t n)
+{
+    double result = a[0];
+    size_t i = 0;
+    if (n >= 2 * LANES)
+    {
+        v2d m0 = load(a), m1 = load(a + LANES);
+        for (i = 2 * LANES; i + 2 * LANES <= n; i += 2 * LANES)
+        {
+            v2d x0 = load(a + i), x1 = load(a + i + LANES);
+            m0 = (x0 > m0) | (x0 != x0) ? x0 : m0;
+            m1 = (x1 > m1) | (x1 != x1) ? x1 : m1;
+        }
+        m0 = (m1 > m0) | (m1 != m1) ? m1 : m0;
+        result = m0[1] > m0[0] || m0[1] != m0[1] ? m0[1] : m0[0];
+    }
+    for (; i < n; ++i)
+        result = a[i] > result || a[i] != a[i] ? a[i] : result;
+    return result;
+}
+
+void kernels::add(double *out, const double *a, const double *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES)
+        store(out + i, load(a + i) + load(b + i));
+    for (; i < n; ++i)
+        out[i] = a[i] + b[i];
+}
+
+void kernels::mul(double *out, const double *a, const double *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES)
+        store(out + i, load(a + i) * load(b + i));
+    for (; i < n; ++i)
+        out[i] = a[i] * b[i];
+}
+
+void kernels::scale(double *out, const double *a, double k, size_t n)
+{
+    v2d kk = {k, k};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES)
+        store(out + i, load(a + i) * kk);
+    for (; i < n; ++i)
+        out[i] = a[i] * k;
+}
+
+void kernels::axpy(double *y, double alpha, const double *x, size_t n)
+{
+    v2d aa = {alpha, alpha};
+    size_t i = 0;
+    for (; i + LANES <= n; i += LANES)
+        store(y + i, load(y + i) + aa * load(x + i));
+    for (; i < n; ++i)
+        y[i] += alpha * x[i];
+}
+
+void kernels::prefixSum(double *out, const double *a, size_t n)
+{
+    // Each element depends on the one before, so this is a plain scan;
+    // it still saves the interpreter a dispatch per element.
+    double total = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        total += a[i];
+        out[i] = total;
+    }
+}
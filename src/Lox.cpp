@@ -0,0 +1,133 @@
+#include "Lox.h"
+#include <utility> // std::move
+#include "Parser.h"
+#include "ProgramCache.h"
+#include "Resolver.h"
+#include "Scanner.h"
+#include "Stats.h"
+#include "Trace.h"
+
+Lox::Lox(std::ostream &out, std::ostream &err)
+    : interpreter_{out, err}
+{
+}
+
+Lox::Lox(OutputSink &out, std::ostream &err)
+    : interpreter_{out, err}
+{
+}
+
+std::shared_ptr<const Program> Lox::compile(std::string_view source)
+{
+    ErrorReporter &errors = interpreter_.errors;
+    bool hadError = errors.hadError;
+    errors.hadError = false;
+
+    std::vector<Token> tokens;
+    {
+        stats::Timer timer{stats::SCAN};
+        trace::Span span{trace::PHASE, "scan"};
+        Scanner scanner{source, errors};
+        tokens = scanner.scanTokens();
+    }
+    stats::add(stats::TOKENS, tokens.size());
+
+    std::vector<std::shared_ptr<Stmt>> statements;
+    {
+        stats::Timer timer{stats::PARSE};
+        trace::Span span{trace::PHASE, "parse"};
+        Parser parser{tokens, errors};
+        statements = parser.parse();
+    }
+
+    if (!errors.hadError)
+    {
+        stats::Timer timer{stats::RESOLVE};
+        trace::Span span{trace::PHASE, "resolve"};
+        Resolver resolver{interpreter_};
+        resolver.resolve(statements);
+    }
+
+    std::shared_ptr<const Program> program;
+    if (!errors.hadError)
+        program = std::make_shared<const Program>(std::move(statements));
+
+    errors.hadError = errors.hadError || hadError;
+    return program;
+}
+
+std::shared_ptr<const Program> Lox::compile(std::string_view source,
+                                            const std::string &cachePath)
+{
+    std::vector<std::shared_ptr<Stmt>> statements;
+    bool loaded;
+    {
+        stats::Timer timer{stats::LOAD};
+        trace::Span span{trace::PHASE, "load"};
+        loaded = loadProgramCache(cachePath, source, statements);
+    }
+    if (loaded)
+        return std::make_shared<const Program>(std::move(statements));
+
+    std::shared_ptr<const Program> program = compile(source);
+    if (program != nullptr)
+        writeProgramCache(cachePath, source, program->statements);
+    return program;
+}
+
+Lox::Status Lox::run(const std::shared_ptr<const Program> &program)
+{
+    ErrorReporter &errors = interpreter_.errors;
+    bool hadRuntimeError = errors.hadRuntimeError;
+    errors.hadRuntimeError = false;
+
+    {
+        stats::Timer timer{stats::INTERPRET};
+        trace::Span span{trace::PHASE, "interpret"};
+        interpreter_.interpret(program);
+    }
+
+    Status status = errors.hadRuntimeError ? Status::RUNTIME_ERROR
+                                           : Status::OK;
+    errors.hadRuntimeError = errors.hadRuntimeError || hadRuntimeError;
+    return status;
+}
+
+Lox::Status Lox::run(std::string_view source)
+{
+    std::shared_ptr<const Program> program = compile(source);
+    if (program == nullptr)
+        return Status::COMPILE_ERROR;
+    return run(program);
+}
+
+std::any Lox::call(const std::string &name, std::vector<std::any> arguments)
+{
+    Token token{IDENTIFIER, name, nullptr, 0};
+    std::any callee = interpreter_.globals->get(token);
+    try
+    {
+        std::any result = interpreter_.call(token, callee, std::move(arguments));
+        interpreter_.output().flush();
+        return result;
+    }
+    catch (...)
+    {
+        interpreter_.output().flush();
+        throw;
+    }
+}
+
+void Lox::define(const std::string &name, std::any value)
+{
+    interpreter_.globals->define(name, std::move(value));
+}
+
+int Lox::exitCode() const
+{
+    if (interpreter_.errors.hadError)
+        return 64;
+    if (interpreter_.errors.hadRuntimeError)
+        return 70;
+    return 0;
+}
@@ -0,0 +1,246 @@
+#include "LoxArray.h"
+#include <cmath> // std::floor
+#include "Environment.h"
+#include "Kernels.h"
+#include "Native.h"
+#include "RuntimeError.h"
+#include "Token.h"
+
+namespace
+{
+    std::any push(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        array.push(std::move(arguments[0]));
+        return nullptr;
+    }
+
+    std::any pop(LoxArray &array, std::vector<std::any> &)
+    {
+        if (array.size() == 0)
+            throw NativeError{"Can't pop from an empty array."};
+        return array.pop();
+    }
+
+    const double *numbers(const LoxArray &array)
+    {
+        if (!array.numeric())
+            throw NativeError{"Array must hold only numbers."};
+        return array.data();
+    }
+
+    const LoxArray &operand(const LoxArray &array, const std::any &value)
+    {
+        const auto &other = expect<Ref<LoxArray>>(value,
+                                                  "Operand must be an array.");
+        if (other->size() != array.size())
+            throw NativeError{"Arrays must have the same length."};
+        numbers(*other);
+        return *other;
+    }
+
+    std::any sum(LoxArray &array, std::vector<std::any> &)
+    {
+        return kernels::sum(numbers(array), array.size());
+    }
+
+    std::any dot(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        const LoxArray &other = operand(array, arguments[0]);
+        return kernels::dot(numbers(array), other.data(), array.size());
+    }
+
+    std::any min(LoxArray &array, std::vector<std::any> &)
+    {
+        const double *data = numbers(array);
+        if (array.size() == 0)
+            throw NativeError{"Can't take the min of an empty array."};
+        return kernels::min(data, array.size());
+    }
+
+    std::any max(LoxArray &array, std::vector<std::any> &)
+    {
+        const double *data = numbers(array);
+        if (array.size() == 0)
+            throw NativeError{"Can't take the max of an empty array."};
+        return kernels::max(data, array.size());
+    }
+
+    std::any add(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        const LoxArray &other = operand(array, arguments[0]);
+        auto result = makeRef<LoxArray>(array.size(), 0.0);
+        kernels::add(result->data(), numbers(array), other.data(),
+                     array.size());
+        return result;
+    }
+
+    std::any mul(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        const LoxArray &other = operand(array, arguments[0]);
+        auto result = makeRef<LoxArray>(array.size(), 0.0);
+        kernels::mul(result->data(), numbers(array), other.data(),
+                     array.size());
+        return result;
+    }
+
+    std::any scale(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        double k = expect<double>(arguments[0], "Factor must be a number.");
+        auto result = makeRef<LoxArray>(array.size(), 0.0);
+        kernels::scale(result->data(), numbers(array), k, array.size());
+        return result;
+    }
+
+    std::any axpy(LoxArray &array, std::vector<std::any> &arguments)
+    {
+        double alpha = expect<double>(arguments[0],
+                                      "Factor must be a number.");
+        const LoxArray &other = operand(array, arguments[1]);
+        numbers(array);
+        kernels::axpy(array.data(), alpha, other.data(), array.size());
+        return nullptr;
+    }
+
+    std::any prefixSum(LoxArray &array, std::vector<std::any> &)
+    {
+        auto result = makeRef<LoxArray>(array.size(), 0.0);
+        kernels::prefixSum(result->data(), numbers(array), array.size());
+        return result;
+    }
+
+    const ArrayMethod::Method methods[] = {
+        {"push", 1, push},
+        {"pop", 0, pop},
+        {"sum", 0, sum},
+        {"dot", 1, dot},
+        {"min", 0, min},
+        {"max", 0, max},
+        {"add", 1, add},
+        {"mul", 1, mul},
+        {"scale", 1, scale},
+        {"axpy", 2, axpy},
+        {"prefixSum", 0, prefixSum},
+    };
+
+    std::any newArray(Interpreter &, std::vector<std::any> &arguments)
+    {
+        if (arguments.empty())
+            return makeRef<LoxArray>();
+
+        double size = expect<double>(arguments[0],
+                                     "Array size must be a number.");
+        if (size < 0 || size != std::floor(size))
+            throw NativeError{"Array size must be a non-negative integer."};
+        std::any fill = arguments.size() > 1 ? arguments[1] : 0.0;
+        return makeRef<LoxArray>(static_cast<size_t>(size), fill);
+    }
+
+    const Native natives[] = {
+        {"Array", 0, newArray, 2},
+    };
+}
+
+LoxArray::LoxArray(size_t size, const std::any &fill)
+{
+    if (fill.type() == typeid(double))
+    {
+        numbers.assign(size, std::any_cast<double>(fill));
+    }
+    else
+    {
+        values.assign(size, fill);
+        boxed = true;
+    }
+}
+
+void LoxArray::box()
+{
+    values.reserve(numbers.size());
+    for (double number : numbers)
+        values.emplace_back(number);
+    numbers.clear();
+    numbers.shrink_to_fit();
+    boxed = true;
+}
+
+size_t LoxArray::size() const
+{
+    return boxed ? values.size() : numbers.size();
+}
+
+std::any LoxArray::at(size_t index) const
+{
+    if (boxed)
+        return values[index];
+    return numbers[index];
+}
+
+void LoxArray::store(size_t index, std::any value)
+{
+    if (!boxed && value.type() == typeid(double))
+    {
+        numbers[index] = std::any_cast<double>(value);
+        return;
+    }
+    if (!boxed)
+        box();
+    values[index] = std::move(value);
+}
+
+void LoxArray::push(std::any value)
+{
+    if (!boxed && value.type() == typeid(double))
+    {
+        numbers.push_back(std::any_cast<double>(value));
+        return;
+    }
+    if (!boxed)
+        box();
+    values.push_back(std::move(value));
+}
+
+std::any LoxArray::pop()
+{
+    if (!boxed)
+    {
+        double last = numbers.back();
+        numbers.pop_back();
+        return last;
+    }
+    std::any last = std::move(values.back());
+    values.pop_back();
+    return last;
+}
+
+bool LoxArray::numeric() const
+{
+    return !boxed;
+}
+
+double *LoxArray::data()
+{
+    return boxed ? nullptr : numbers.data();
+}
+
+const double *LoxArray::data() const
+{
+    return boxed ? nullptr : numbers.data();
+}
+
+std::any LoxArray::get(const Token &name)
+{
+    if (name.lexeme == "length")
+        return static_cast<double>(size());
+
+    if (auto method = ArrayMethod::bind(this, methods, name.lexeme))
+        return method;
+
+    throw RuntimeError(name,
+                       "Undefined property '" + name.lexeme + "'.");
+}
+
+void LoxArray::defineNatives(Environment &globals)
+{
+    for (const Native &native : natives)
+        globals.define(native.name, &native);
+}
@@ -1,13 +1,14 @@
 #include "LoxClass.h"
 #include <utility> // std::move
+#include "Trace.h"
 
 LoxClass::LoxClass(std::string name,
-                   std::map<std::string, std::shared_ptr<LoxFunction>> methods)
+                   std::map<std::string, Ref<LoxFunction>> methods)
     : name{std::move(name)}, methods{std::move(methods)}
 {
 }
 
-std::shared_ptr<LoxFunction> LoxClass::findMethod(const std::string &name)
+Ref<LoxFunction> LoxClass::findMethod(const std::string &name)
 {
     auto elem = methods.find(name);
 
@@ -21,7 +22,7 @@ std::shared_ptr<LoxFunction> LoxClass::findMethod(const std::string &name)
 
 int LoxClass::arity()
 {
-    std::shared_ptr<LoxFunction> initializer = findMethod("init");
+    Ref<LoxFunction> initializer = findMethod("init");
     if (initializer == nullptr)
         return 0;
     return initializer->arity();
@@ -29,8 +30,9 @@ int LoxClass::arity()
 std::any LoxClass::call(Interpreter &interpreter,
                         std::vector<std::any> arguments)
 {
-    auto instance = std::make_shared<LoxInstance>(shared_from_this());
-    std::shared_ptr<LoxFunction> initializer = findMethod("init");
+    trace::Span span{trace::CLASS, name};
+    auto instance = makeRef<LoxInstance>(Ref<LoxClass>{this});
+    Ref<LoxFunction> initializer = findMethod("init");
     if (initializer != nullptr)
     {
         initializer->bind(instance)->call(interpreter,
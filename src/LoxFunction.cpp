@@ -1,25 +1,37 @@
 #include "LoxFunction.h"
 #include <utility> // std::move
+#include "Allocations.h"
 #include "Environment.h"
+#include "EventLoop.h"
 #include "LoxInstance.h"
 #include "Interpreter.h"
 #include "Stmt.h"
+#include "Trace.h"
 
-LoxFunction::LoxFunction(std::shared_ptr<FunctionStmt> declaration,
-                         std::shared_ptr<Environment> closure,
+LoxFunction::LoxFunction(const FunctionStmt *declaration,
+                         Ref<Environment> closure,
                          bool isInitializer)
     : isInitializer{isInitializer}, closure{std::move(closure)},
-      declaration{std::move(declaration)}
+      declaration{declaration}
 {
+    if (allocations::enabled)
+        allocations::allocated(allocations::FUNCTION, this,
+                               sizeof(LoxFunction));
 }
 
-std::shared_ptr<LoxFunction> LoxFunction::bind(
-    std::shared_ptr<LoxInstance> instance)
+LoxFunction::~LoxFunction()
 {
-    auto environment = std::make_shared<Environment>(closure);
+    if (allocations::enabled)
+        allocations::freed(this);
+}
+
+Ref<LoxFunction> LoxFunction::bind(
+    Ref<LoxInstance> instance)
+{
+    auto environment = makeRef<Environment>(closure);
     environment->define("this", instance);
     
-    return std::make_shared<LoxFunction>(declaration, environment,
+    return makeRef<LoxFunction>(declaration, environment,
                                          isInitializer);
 }
 
@@ -36,13 +48,29 @@ int LoxFunction::arity()
 std::any LoxFunction::call(Interpreter &interpreter,
                            std::vector<std::any> arguments)
 {
-    auto environment = std::make_shared<Environment>(closure);
+    // A coroutine's stack is much smaller than the main one.
+    if (interpreter.loop != nullptr && interpreter.loop->stackExhausted())
+        throw RuntimeError{declaration->name, "Stack overflow."};
+
+    auto environment = makeRef<Environment>(closure);
     for (int i = 0; i < declaration->params.size(); ++i)
     {
         environment->define(declaration->params[i].lexeme,
                             arguments[i]);
     }
 
+    trace::Span span{trace::FUNCTION, declaration->name.lexeme,
+                     declaration->name.line};
+
+    // Popped however the call ends.
+    struct Frame
+    {
+        Interpreter &interpreter;
+        ~Frame() { interpreter.frames.pop_back(); }
+    } frame{interpreter};
+    interpreter.frames.push_back(
+        CallFrame{declaration, interpreter.environment.get()});
+
     try
     {
         interpreter.executeBlock(declaration->body, environment);
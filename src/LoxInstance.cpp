@@ -1,11 +1,23 @@
 #include"LoxInstance.h"
 #include <utility>        // std::move
+#include "Allocations.h"
 #include "Error.h"
+#include "Stats.h"
 #include "Token.h"
 
-LoxInstance::LoxInstance(std::shared_ptr<LoxClass> klass)
+LoxInstance::LoxInstance(Ref<LoxClass> klass)
   : klass{std::move(klass)}
-{}
+{
+  stats::add(stats::INSTANCES);
+  if (allocations::enabled)
+    allocations::allocated(allocations::INSTANCE, this, sizeof(LoxInstance));
+}
+
+LoxInstance::~LoxInstance()
+{
+  if (allocations::enabled)
+    allocations::freed(this);
+}
 
 std::any LoxInstance::get(const Token& name) {
   auto elem = fields.find(name.lexeme);
@@ -13,10 +25,10 @@ std::any LoxInstance::get(const Token& name) {
     return elem->second;
   }
 
-  std::shared_ptr<LoxFunction> method =
+  Ref<LoxFunction> method =
       klass->findMethod(name.lexeme);
   //if (method != nullptr) return method;
-  if (method != nullptr) return method->bind(shared_from_this());
+  if (method != nullptr) return method->bind(Ref<LoxInstance>{this});
 
   throw RuntimeError(name,
       "Undefined property '" + name.lexeme + "'.");
@@ -0,0 +1,308 @@
+#include "LoxMap.h"
+#include <cmath>      // std::isnan
+#include <cstring>    // std::memcpy
+#include <functional> // std::hash
+#include <string_view>
+#include "Environment.h"
+#include "LoxArray.h"
+#include "Native.h"
+#include "RuntimeError.h"
+#include "Token.h"
+
+namespace
+{
+    // Control bytes.  A full slot holds the low seven bits of its key's
+    // hash, so the high bit alone tells free slots from full ones.
+    constexpr uint8_t EMPTY = 0x80;
+    constexpr uint8_t DELETED = 0xfe;
+
+    constexpr size_t GROUP = 8;
+    constexpr uint64_t LSBS = 0x0101010101010101ull;
+    constexpr uint64_t MSBS = 0x8080808080808080ull;
+
+    uint64_t loadGroup(const uint8_t *control)
+    {
+        uint64_t group;
+        std::memcpy(&group, control, sizeof group);
+        return group;
+    }
+
+    // One bit per byte of the group that may hold h2; false positives
+    // are possible and are weeded out by comparing keys.
+    uint64_t matchByte(uint64_t group, uint8_t h2)
+    {
+        uint64_t x = group ^ (LSBS * h2);
+        return (x - LSBS) & ~x & MSBS;
+    }
+
+    uint64_t matchEmpty(uint64_t group)
+    {
+        return group & ~(group << 6) & MSBS;
+    }
+
+    uint64_t matchFree(uint64_t group)
+    {
+        return group & MSBS;
+    }
+
+    size_t firstByte(uint64_t mask)
+    {
+        return __builtin_ctzll(mask) / 8;
+    }
+
+    uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    const std::any &key(const std::any &value)
+    {
+        if (!LoxMap::isKey(value))
+            throw NativeError{"Map keys must be strings or numbers."};
+        return value;
+    }
+
+    std::any get(LoxMap &map, std::vector<std::any> &arguments)
+    {
+        return map.at(key(arguments[0]));
+    }
+
+    std::any set(LoxMap &map, std::vector<std::any> &arguments)
+    {
+        map.store(key(arguments[0]), std::move(arguments[1]));
+        return nullptr;
+    }
+
+    std::any has(LoxMap &map, std::vector<std::any> &arguments)
+    {
+        return map.contains(key(arguments[0]));
+    }
+
+    std::any erase(LoxMap &map, std::vector<std::any> &arguments)
+    {
+        return map.erase(key(arguments[0]));
+    }
+
+    std::any keys(LoxMap &map, std::vector<std::any> &)
+    {
+        auto array = makeRef<LoxArray>();
+        map.forEach([&](const std::any &key, const std::any &)
+                    { array->push(key); });
+        return array;
+    }
+
+    std::any values(LoxMap &map, std::vector<std::any> &)
+    {
+        auto array = makeRef<LoxArray>();
+        map.forEach([&](const std::any &, const std::any &value)
+                    { array->push(value); });
+        return array;
+    }
+
+    const MapMethod::Method methods[] = {
+        {"get", 1, get},
+        {"set", 2, set},
+        {"has", 1, has},
+        {"delete", 1, erase},
+        {"keys", 0, keys},
+        {"values", 0, values},
+    };
+
+    std::any newMap(Interpreter &, std::vector<std::any> &)
+    {
+        return makeRef<LoxMap>();
+    }
+
+    const Native natives[] = {
+        {"Map", 0, newMap},
+    };
+}
+
+bool LoxMap::isKey(const std::any &value)
+{
+    if (value.type() == typeid(std::string))
+        return true;
+    return value.type() == typeid(double) &&
+           !std::isnan(std::any_cast<double>(value));
+}
+
+uint64_t LoxMap::hash(const std::any &key)
+{
+    if (key.type() == typeid(std::string))
+    {
+        const auto &string = std::any_cast<const std::string &>(key);
+        return mix(std::hash<std::string_view>{}(string));
+    }
+
+    double number = std::any_cast<double>(key);
+    if (number == 0)
+        number = 0; // -0 and 0 are the same key
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof bits);
+    return mix(bits);
+}
+
+bool LoxMap::equal(const std::any &a, const std::any &b)
+{
+    if (a.type() != b.type())
+        return false;
+    if (a.type() == typeid(double))
+        return std::any_cast<double>(a) == std::any_cast<double>(b);
+    return std::any_cast<const std::string &>(a) ==
+           std::any_cast<const std::string &>(b);
+}
+
+size_t LoxMap::find(const std::any &key, uint64_t hash) const
+{
+    if (control.empty())
+        return NONE;
+
+    size_t groups = control.size() / GROUP;
+    size_t group = (hash >> 7) & (groups - 1);
+    uint8_t h2 = hash & 0x7f;
+
+    // Triangular probing visits every group once when the number of
+    // groups is a power of two.
+    for (size_t step = 1; step <= groups; ++step)
+    {
+        uint64_t bytes = loadGroup(&control[group * GROUP]);
+        for (uint64_t match = matchByte(bytes, h2); match != 0;
+             match &= match - 1)
+        {
+            size_t slot = group * GROUP + firstByte(match);
+            const Entry &entry = entries[slots[slot]];
+            if (entry.hash == hash && equal(entry.key, key))
+                return slot;
+        }
+        if (matchEmpty(bytes) != 0)
+            return NONE;
+        group = (group + step) & (groups - 1);
+    }
+    return NONE;
+}
+
+size_t LoxMap::freeSlot(uint64_t hash) const
+{
+    size_t groups = control.size() / GROUP;
+    size_t group = (hash >> 7) & (groups - 1);
+    for (size_t step = 1;; ++step)
+    {
+        uint64_t match = matchFree(loadGroup(&control[group * GROUP]));
+        if (match != 0)
+            return group * GROUP + firstByte(match);
+        group = (group + step) & (groups - 1);
+    }
+}
+
+void LoxMap::rebuild(size_t capacity)
+{
+    // Drops deleted entries and re-indexes the rest from their cached
+    // hashes.
+    size_t next = 0;
+    for (Entry &entry : entries)
+    {
+        if (entry.key.has_value())
+            entries[next++] = std::move(entry);
+    }
+    entries.resize(next);
+
+    control.assign(capacity, EMPTY);
+    slots.assign(capacity, NONE);
+    for (uint32_t index = 0; index < entries.size(); ++index)
+    {
+        size_t slot = freeSlot(entries[index].hash);
+        control[slot] = entries[index].hash & 0x7f;
+        slots[slot] = index;
+    }
+    used = live;
+}
+
+size_t LoxMap::size() const
+{
+    return live;
+}
+
+std::any LoxMap::at(const std::any &key) const
+{
+    size_t slot = find(key, hash(key));
+    if (slot == NONE)
+        return nullptr;
+    return entries[slots[slot]].value;
+}
+
+void LoxMap::store(const std::any &key, std::any value)
+{
+    uint64_t h = hash(key);
+    size_t slot = find(key, h);
+    if (slot != NONE)
+    {
+        entries[slots[slot]].value = std::move(value);
+        return;
+    }
+
+    // Keep at least one slot in eight empty so probes terminate quickly.
+    if ((used + 1) * 8 > control.size() * 7)
+    {
+        size_t capacity = control.empty() ? GROUP : control.size();
+        while ((live + 1) * 8 > capacity * 7 / 2)
+            capacity *= 2;
+        rebuild(capacity);
+    }
+
+    slot = freeSlot(h);
+    if (control[slot] == EMPTY)
+        ++used;
+    control[slot] = h & 0x7f;
+    slots[slot] = entries.size();
+    if (key.type() == typeid(double) && std::any_cast<double>(key) == 0)
+        entries.push_back(Entry{0.0, std::move(value), h});
+    else
+        entries.push_back(Entry{key, std::move(value), h});
+    ++live;
+}
+
+bool LoxMap::contains(const std::any &key) const
+{
+    return find(key, hash(key)) != NONE;
+}
+
+bool LoxMap::erase(const std::any &key)
+{
+    size_t slot = find(key, hash(key));
+    if (slot == NONE)
+        return false;
+
+    Entry &entry = entries[slots[slot]];
+    entry.key.reset();
+    entry.value.reset();
+    control[slot] = DELETED;
+    slots[slot] = NONE;
+    --live;
+
+    // Compact once most entries are holes, so iteration stays cheap.
+    if (entries.size() > 16 && live < entries.size() / 2)
+        rebuild(control.size());
+    return true;
+}
+
+std::any LoxMap::get(const Token &name)
+{
+    if (name.lexeme == "size")
+        return static_cast<double>(size());
+
+    if (auto method = MapMethod::bind(this, methods, name.lexeme))
+        return method;
+
+    throw RuntimeError(name,
+                       "Undefined property '" + name.lexeme + "'.");
+}
+
+void LoxMap::defineNatives(Environment &globals)
+{
+    for (const Native &native : natives)
+        globals.define(native.name, &native);
+}
@@ -0,0 +1,131 @@
+#include "Native.h"
+#include <algorithm> // std::sort
+#include <chrono>
+#include <cmath>     // std::floor
+#include <ctime>     // clock_gettime
+#include <iostream>
+#include "Allocations.h"
+#include "Environment.h"
+#include "EventLoop.h"
+#include "HeapSnapshot.h"
+#include "Interpreter.h"
+#include "LoxArray.h"
+#include "LoxMap.h"
+#include "Task.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // bench() keeps every time to find the median.
+    constexpr double MAX_BENCH_ITERATIONS = 1e7;
+
+    // Seconds on a monotonic clock, for differences.
+    std::any clock(Interpreter &, std::vector<std::any> &)
+    {
+        return std::chrono::duration<double>{Clock::now().time_since_epoch()}
+            .count();
+    }
+
+    std::any nanoTime(Interpreter &, std::vector<std::any> &)
+    {
+        return static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now().time_since_epoch())
+                .count());
+    }
+
+    // Seconds of CPU time used by the process, on all threads.
+    std::any cpuTime(Interpreter &, std::vector<std::any> &)
+    {
+        timespec time;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+
+    // bench(fn, iterations): calls fn() iterations / 10 times (at least
+    // once) to warm up, then times each of `iterations` calls.  Returns a
+    // map of iterations, min, median, mean and max in nanoseconds.
+    std::any bench(Interpreter &interpreter, std::vector<std::any> &arguments)
+    {
+        double count = expect<double>(arguments[1],
+                                      "Iterations must be a number.");
+        if (!(count >= 1) || std::floor(count) != count)
+            throw NativeError{"Iterations must be a positive integer."};
+        if (count > MAX_BENCH_ITERATIONS)
+            throw NativeError{"Iterations must be at most 10000000."};
+        size_t iterations = static_cast<size_t>(count);
+
+        // Errors calling fn are reported where bench() was called.
+        Token token = interpreter.callSite();
+        for (size_t i = 0; i < std::max<size_t>(1, iterations / 10); ++i)
+            interpreter.call(token, arguments[0], {});
+
+        std::vector<double> times(iterations);
+        for (double &time : times)
+        {
+            auto start = Clock::now();
+            interpreter.call(token, arguments[0], {});
+            time = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                       .count();
+        }
+
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double time : times)
+            total += time;
+        size_t middle = iterations / 2;
+        double median = iterations % 2 ? times[middle]
+                                       : (times[middle - 1] + times[middle]) / 2;
+
+        auto result = makeRef<LoxMap>();
+        result->store(std::string{"iterations"}, count);
+        result->store(std::string{"min"}, times.front());
+        result->store(std::string{"median"}, median);
+        result->store(std::string{"mean"}, total / iterations);
+        result->store(std::string{"max"}, times.back());
+        return result;
+    }
+
+    // Prints the allocations so far to stderr; see --alloc-profile.
+    std::any allocationReport(Interpreter &interpreter,
+                              std::vector<std::any> &)
+    {
+        interpreter.output().flush();
+        allocations::report(std::cerr, interpreter.retained());
+        return nullptr;
+    }
+
+    // Writes a heap snapshot and returns its path; see HeapSnapshot.
+    std::any heapSnapshot(Interpreter &interpreter,
+                          std::vector<std::any> &arguments)
+    {
+        std::string path;
+        if (!arguments.empty())
+            path = expect<std::string>(arguments[0], "Path must be a string.");
+        path = HeapSnapshot::take(interpreter, path);
+        if (path.empty())
+            throw NativeError{"Could not write the heap snapshot."};
+        return path;
+    }
+
+    const Native natives[] = {
+        {"clock", 0, clock},
+        {"nanoTime", 0, nanoTime},
+        {"cpuTime", 0, cpuTime},
+        {"bench", 2, bench},
+        {"allocationReport", 0, allocationReport},
+        {"heapSnapshot", 0, heapSnapshot, 1},
+    };
+}
+
+void defineNatives(Environment &globals)
+{
+    for (const Native &native : natives)
+        globals.define(native.name, &native);
+
+    LoxArray::defineNatives(globals);
+    LoxMap::defineNatives(globals);
+    tasks::defineNatives(globals);
+    EventLoop::defineNatives(globals);
+}
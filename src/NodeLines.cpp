@@ -0,0 +1,186 @@
+#include "NodeLines.h"
+#include "Expr.h"
+#include "Program.h"
+#include "Stmt.h"
+
+namespace
+{
+    class Lines : public ExprVisitor, public StmtVisitor
+    {
+        int parent = 1;
+
+        int add(const void *node, int line, const char *branch = nullptr)
+        {
+            lines.push_back(NodeLine{node, line, branch});
+            return line;
+        }
+
+        int visit(const std::shared_ptr<Expr> &expr, int line)
+        {
+            if (expr == nullptr)
+                return line;
+            int saved = parent;
+            parent = line;
+            int result = std::any_cast<int>(expr->accept(*this));
+            parent = saved;
+            return result;
+        }
+
+        int visit(const std::shared_ptr<Stmt> &stmt, int line)
+        {
+            if (stmt == nullptr)
+                return line;
+            int saved = parent;
+            parent = line;
+            int result = std::any_cast<int>(stmt->accept(*this));
+            parent = saved;
+            return result;
+        }
+
+        int visit(const std::vector<std::shared_ptr<Stmt>> &statements,
+                  int line)
+        {
+            int first = line;
+            for (size_t i = 0; i < statements.size(); ++i)
+            {
+                int at = visit(statements[i], line);
+                if (i == 0)
+                    first = at;
+            }
+            return first;
+        }
+
+    public:
+        std::vector<NodeLine> lines;
+
+        void find(const Program &program)
+        {
+            visit(program.statements, 1);
+        }
+
+        std::any visitAssignExpr(AssignExpr *expr) override
+        {
+            visit(expr->value, expr->name.line);
+            return add(expr, expr->name.line);
+        }
+        std::any visitBinaryExpr(BinaryExpr *expr) override
+        {
+            visit(expr->left, expr->op.line);
+            visit(expr->right, expr->op.line);
+            return add(expr, expr->op.line);
+        }
+        std::any visitCallExpr(CallExpr *expr) override
+        {
+            int line = visit(expr->callee, expr->paren.line);
+            for (const std::shared_ptr<Expr> &argument : expr->arguments)
+                visit(argument, line);
+            return add(expr, line);
+        }
+        std::any visitGetExpr(GetExpr *expr) override
+        {
+            visit(expr->object, expr->name.line);
+            return add(expr, expr->name.line);
+        }
+        std::any visitGroupingExpr(GroupingExpr *expr) override
+        {
+            return add(expr, visit(expr->expression, parent));
+        }
+        std::any visitLiteralExpr(LiteralExpr *expr) override
+        {
+            return add(expr, parent);
+        }
+        std::any visitLogicalExpr(LogicalExpr *expr) override
+        {
+            visit(expr->left, expr->op.line);
+            visit(expr->right, expr->op.line);
+            return add(expr, expr->op.line,
+                       expr->op.type == OR ? "or" : "and");
+        }
+        std::any visitSetExpr(SetExpr *expr) override
+        {
+            visit(expr->object, expr->name.line);
+            visit(expr->value, expr->name.line);
+            return add(expr, expr->name.line);
+        }
+        std::any visitThisExpr(ThisExpr *expr) override
+        {
+            return add(expr, expr->keyword.line);
+        }
+        std::any visitUnaryExpr(UnaryExpr *expr) override
+        {
+            visit(expr->right, expr->op.line);
+            return add(expr, expr->op.line);
+        }
+        std::any visitVariableExpr(VariableExpr *expr) override
+        {
+            return add(expr, expr->name.line);
+        }
+        std::any visitIndexExpr(IndexExpr *expr) override
+        {
+            visit(expr->object, expr->bracket.line);
+            visit(expr->index, expr->bracket.line);
+            return add(expr, expr->bracket.line);
+        }
+        std::any visitIndexSetExpr(IndexSetExpr *expr) override
+        {
+            visit(expr->object, expr->bracket.line);
+            visit(expr->index, expr->bracket.line);
+            visit(expr->value, expr->bracket.line);
+            return add(expr, expr->bracket.line);
+        }
+
+        std::any visitBlockStmt(BlockStmt *stmt) override
+        {
+            return add(stmt, visit(stmt->statements, parent));
+        }
+        std::any visitClassStmt(ClassStmt *stmt) override
+        {
+            for (const std::shared_ptr<FunctionStmt> &method : stmt->methods)
+                visitFunctionStmt(method.get());
+            return add(stmt, stmt->name.line);
+        }
+        std::any visitExpressionStmt(ExpressionStmt *stmt) override
+        {
+            return add(stmt, visit(stmt->expression, parent));
+        }
+        std::any visitFunctionStmt(FunctionStmt *stmt) override
+        {
+            visit(stmt->body, stmt->name.line);
+            return add(stmt, stmt->name.line);
+        }
+        std::any visitIfStmt(IfStmt *stmt) override
+        {
+            int line = visit(stmt->condition, parent);
+            visit(stmt->thenBranch, line);
+            visit(stmt->elseBranch, line);
+            return add(stmt, line, "if");
+        }
+        std::any visitPrintStmt(PrintStmt *stmt) override
+        {
+            return add(stmt, visit(stmt->expression, parent));
+        }
+        std::any visitReturnStmt(ReturnStmt *stmt) override
+        {
+            visit(stmt->value, stmt->keyword.line);
+            return add(stmt, stmt->keyword.line);
+        }
+        std::any visitVarStmt(VarStmt *stmt) override
+        {
+            visit(stmt->initializer, stmt->name.line);
+            return add(stmt, stmt->name.line);
+        }
+        std::any visitWhileStmt(WhileStmt *stmt) override
+        {
+            int line = visit(stmt->condition, parent);
+            visit(stmt->body, line);
+            return add(stmt, line, "while");
+        }
+    };
+}
+
+std::vector<NodeLine> nodeLines(const Program &program)
+{
+    Lines lines;
+    lines.find(program);
+    return std::move(lines.lines);
+}
@@ -0,0 +1,34 @@
+#include "NumberFormat.h"
+#include <charconv> // std::to_chars
+#include <cmath>    // std::isnan, std::isinf, std::fabs
+#include <cstring>  // std::memcpy
+
+size_t numbers::format(double value, char *buffer)
+{
+    if (std::isnan(value))
+    {
+        std::memcpy(buffer, "nan", 3);
+        return 3;
+    }
+    if (std::isinf(value))
+    {
+        if (value < 0)
+        {
+            std::memcpy(buffer, "-inf", 4);
+            return 4;
+        }
+        std::memcpy(buffer, "inf", 3);
+        return 3;
+    }
+
+    // Without a precision, to_chars picks the shortest digits that round
+    // trip (Ryu) in whichever notation it is asked for.
+    double magnitude = std::fabs(value);
+    std::chars_format notation =
+        magnitude == 0 || (magnitude >= 1e-6 && magnitude < 1e21)
+            ? std::chars_format::fixed
+            : std::chars_format::scientific;
+    std::to_chars_result result =
+        std::to_chars(buffer, buffer + MAX_LENGTH, value, notation);
+    return result.ptr - buffer;
+}
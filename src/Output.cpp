@@ -0,0 +1,56 @@
+#include "Output.h"
+#include <ostream>
+
+StreamSink::StreamSink(std::ostream &stream)
+    : stream{stream}
+{
+}
+
+void StreamSink::write(std::string_view bytes)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    stream.write(bytes.data(), bytes.size());
+    stream.flush();
+}
+
+void StringSink::write(std::string_view bytes)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    text.append(bytes);
+}
+
+std::string StringSink::str()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return text;
+}
+
+Output::Output(OutputSink &sink, size_t threshold)
+    : sink_{&sink}, threshold_{threshold}
+{
+}
+
+Output::~Output()
+{
+    flush();
+}
+
+void Output::flush()
+{
+    if (buffer_.empty())
+        return;
+    sink_->write(buffer_);
+    buffer_.clear();
+}
+
+void Output::setSink(OutputSink &sink)
+{
+    flush();
+    sink_ = &sink;
+}
+
+void Output::setThreshold(size_t threshold)
+{
+    threshold_ = threshold;
+    written();
+}
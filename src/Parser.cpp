@@ -1,7 +1,7 @@
 #include "Parser.h"
 
-Parser::Parser(const std::vector<Token> &tokens)
-    : tokens(tokens)
+Parser::Parser(const std::vector<Token> &tokens, ErrorReporter &errors)
+    : tokens(tokens), errors(errors)
 {
 }
 
@@ -32,6 +32,11 @@ std::shared_ptr<Expr> Parser::assignment()
         {
             return std::make_shared<SetExpr>(get->object, get->name, value);
         }
+        else if (IndexExpr *index = dynamic_cast<IndexExpr *>(expr.get()))
+        {
+            return std::make_shared<IndexSetExpr>(index->object, index->bracket,
+                                                  index->index, value);
+        }
 
         error(std::move(equals), "Invalid assignment target.");
     }
@@ -173,6 +178,12 @@ std::shared_ptr<Expr> Parser::call()
             Token name = consume(IDENTIFIER, "Expect property name after '.'.");
             expr = std::make_shared<GetExpr>(expr, std::move(name));
         }
+        else if (match(LEFT_BRACKET))
+        {
+            std::shared_ptr<Expr> index = expression();
+            Token bracket = consume(RIGHT_BRACKET, "Expect ']' after index.");
+            expr = std::make_shared<IndexExpr>(expr, std::move(bracket), index);
+        }
         else
         {
             break;
@@ -0,0 +1,154 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <ostream>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    struct Config
+    {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr uint64_t cache(uint64_t id, uint64_t op, uint64_t result)
+    {
+        return id | op << 8 | result << 16;
+    }
+
+    const Config configs[PerfCounters::EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE,
+         cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+               PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    };
+
+    int open(const Config &config, pid_t pid)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof attr;
+        attr.type = config.type;
+        attr.config = config.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1; // allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.enable_on_exec = pid != 0;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(
+            syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+}
+
+const char *const PerfCounters::names[EVENTS] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses",
+};
+
+PerfCounters::PerfCounters(pid_t pid)
+{
+    for (int event = 0; event < EVENTS; ++event)
+    {
+        fds[event] = open(configs[event], pid);
+        if (fds[event] < 0 && error.empty())
+            error = std::strerror(errno);
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+bool PerfCounters::available() const
+{
+    for (int event = 0; event < EVENTS; ++event)
+    {
+        if (available(static_cast<Event>(event)))
+            return true;
+    }
+    return false;
+}
+
+bool PerfCounters::available(Event event) const
+{
+    return fds[event] >= 0;
+}
+
+void PerfCounters::start()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+uint64_t PerfCounters::read(Event event) const
+{
+    uint64_t values[3]; // count, time enabled, time running
+    if (fds[event] < 0 ||
+        ::read(fds[event], values, sizeof values) != sizeof values ||
+        values[2] == 0)
+    {
+        return 0;
+    }
+    if (values[2] == values[1])
+        return values[0];
+    return static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] /
+                                 values[2]);
+}
+
+void PerfCounters::print(std::ostream &out) const
+{
+    if (!available())
+    {
+        out << "perf counters unavailable: " << error << "\n";
+        return;
+    }
+
+    char line[96];
+    for (int event = 0; event < EVENTS; ++event)
+    {
+        if (available(static_cast<Event>(event)))
+            std::snprintf(line, sizeof line, "%-14s %16llu\n", names[event],
+                          static_cast<unsigned long long>(
+                              read(static_cast<Event>(event))));
+        else
+            std::snprintf(line, sizeof line, "%-14s %16s\n", names[event],
+                          "-");
+        out << line;
+    }
+
+    uint64_t cycles = read(CYCLES);
+    if (cycles != 0 && available(INSTRUCTIONS))
+    {
+        std::snprintf(line, sizeof line, "%-14s %16.2f\n", "ipc",
+                      static_cast<double>(read(INSTRUCTIONS)) / cycles);
+        out << line;
+    }
+}
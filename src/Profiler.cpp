@@ -0,0 +1,145 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <sys/time.h>
+#include <unordered_map>
+#include <unordered_set>
+#include "Stmt.h"
+
+namespace
+{
+    // Samples from every thread, by folded stack.
+    std::mutex mutex;
+    std::unordered_map<std::string, uint64_t> stacks;
+
+    void tick(int)
+    {
+        profiler::pending = profiler::pending + 1;
+    }
+
+    void setTimer(long microseconds)
+    {
+        itimerval timer{};
+        timer.it_interval.tv_sec = microseconds / 1000000;
+        timer.it_interval.tv_usec = microseconds % 1000000;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+
+    // The frames of a folded stack, root first.
+    std::vector<std::string> split(const std::string &stack)
+    {
+        std::vector<std::string> frames;
+        size_t start = 0;
+        for (size_t end; (end = stack.find(';', start)) != std::string::npos;
+             start = end + 1)
+        {
+            frames.push_back(stack.substr(start, end - start));
+        }
+        frames.push_back(stack.substr(start));
+        return frames;
+    }
+}
+
+void profiler::start(int hz)
+{
+    struct sigaction action{};
+    action.sa_handler = tick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    setTimer(std::max(1, 1000000 / std::max(1, hz)));
+}
+
+void profiler::stop()
+{
+    setTimer(0);
+    std::signal(SIGPROF, SIG_IGN);
+}
+
+void profiler::sample(const std::vector<CallFrame> &frames)
+{
+    uint64_t weight = pending;
+    pending = 0;
+
+    std::string stack = "<script>";
+    for (const CallFrame &frame : frames)
+    {
+        const FunctionStmt *function = frame.function;
+        stack += ';';
+        stack += function->name.lexeme;
+        stack += ':';
+        stack += std::to_string(function->name.line);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    stacks[stack] += weight;
+}
+
+void profiler::writeFolded(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    std::map<std::string, uint64_t> sorted{stacks.begin(), stacks.end()};
+    for (const auto &[stack, count] : sorted)
+        out << stack << " " << count << "\n";
+}
+
+void profiler::printTop(std::ostream &out, size_t top)
+{
+    struct Time
+    {
+        uint64_t self = 0;
+        uint64_t total = 0;
+    };
+
+    std::unordered_map<std::string, Time> functions;
+    uint64_t samples = 0;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (const auto &[stack, count] : stacks)
+        {
+            std::vector<std::string> frames = split(stack);
+            functions[frames.back()].self += count;
+            // Recursive functions count once per sample.
+            std::unordered_set<std::string> seen;
+            for (const std::string &frame : frames)
+            {
+                if (seen.insert(frame).second)
+                    functions[frame].total += count;
+            }
+            samples += count;
+        }
+    }
+
+    std::vector<std::pair<std::string, Time>> sorted{functions.begin(),
+                                                     functions.end()};
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+              { return a.second.self != b.second.self
+                           ? a.second.self > b.second.self
+                           : a.second.total > b.second.total; });
+    if (sorted.size() > top)
+        sorted.resize(top);
+
+    char line[160];
+    std::snprintf(line, sizeof line, "%8s %7s %8s %7s  %s\n", "self", "",
+                  "total", "", "function");
+    out << line;
+    for (const auto &[name, time] : sorted)
+    {
+        std::snprintf(line, sizeof line, "%8llu %6.2f%% %8llu %6.2f%%  %s\n",
+                      static_cast<unsigned long long>(time.self),
+                      100.0 * time.self / samples,
+                      static_cast<unsigned long long>(time.total),
+                      100.0 * time.total / samples, name.c_str());
+        out << line;
+    }
+    std::snprintf(line, sizeof line, "%llu samples\n",
+                  static_cast<unsigned long long>(samples));
+    out << line;
+}
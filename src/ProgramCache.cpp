@@ -0,0 +1,795 @@
+#include "ProgramCache.h"
+#include <cstdio>   // std::rename, std::remove
+#include <cstring>  // std::memcmp, std::memcpy
+#include <fstream>
+#include <functional> // std::hash
+#include <thread>
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+namespace
+{
+    enum Tag : uint8_t
+    {
+        NONE = 0,
+
+        ASSIGN_EXPR = 1,
+        BINARY_EXPR,
+        GROUPING_EXPR,
+        LITERAL_EXPR,
+        UNARY_EXPR,
+        VARIABLE_EXPR,
+        LOGICAL_EXPR,
+        CALL_EXPR,
+        GET_EXPR,
+        SET_EXPR,
+        THIS_EXPR,
+        INDEX_EXPR,
+        INDEX_SET_EXPR,
+
+        BLOCK_STMT = 32,
+        EXPRESSION_STMT,
+        PRINT_STMT,
+        VAR_STMT,
+        IF_STMT,
+        WHILE_STMT,
+        FUNCTION_STMT,
+        RETURN_STMT,
+        CLASS_STMT,
+    };
+
+    enum LiteralTag : uint8_t
+    {
+        LITERAL_NIL,
+        LITERAL_FALSE,
+        LITERAL_TRUE,
+        LITERAL_NUMBER,
+        LITERAL_STRING,
+    };
+
+    constexpr size_t HEADER_SIZE = 4 + 4 + 8 * 4;
+}
+
+using loxc::getU32;
+using loxc::getU64;
+using loxc::putU32;
+using loxc::putU64;
+
+void loxc::putU32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void loxc::putU64(std::string &out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+uint32_t loxc::getU32(const char *p)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+        value |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return value;
+}
+
+uint64_t loxc::getU64(const char *p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+        value |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return value;
+}
+
+uint64_t loxc::hash(std::string_view bytes)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : bytes)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string loxc::cachePath(std::string_view scriptPath)
+{
+    std::string path{scriptPath};
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".lox") == 0)
+        return path + "c";
+    return path + ".loxc";
+}
+
+// ---------------------------------------------------------------- writer
+
+void AstWriter::writeU8(uint8_t value)
+{
+    out.push_back(static_cast<char>(value));
+}
+
+void AstWriter::writeU32(uint32_t value)
+{
+    putU32(out, value);
+}
+
+void AstWriter::writeI32(int32_t value)
+{
+    writeU32(static_cast<uint32_t>(value));
+}
+
+void AstWriter::writeString(std::string_view value)
+{
+    writeU32(value.size());
+    out.append(value);
+}
+
+void AstWriter::writeLiteral(const std::any &value)
+{
+    if (value.type() == typeid(nullptr))
+    {
+        writeU8(LITERAL_NIL);
+    }
+    else if (value.type() == typeid(bool))
+    {
+        writeU8(std::any_cast<bool>(value) ? LITERAL_TRUE : LITERAL_FALSE);
+    }
+    else if (value.type() == typeid(double))
+    {
+        double number = std::any_cast<double>(value);
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof bits);
+        writeU8(LITERAL_NUMBER);
+        putU64(out, bits);
+    }
+    else if (value.type() == typeid(std::string))
+    {
+        writeU8(LITERAL_STRING);
+        writeString(std::any_cast<const std::string &>(value));
+    }
+    else
+    {
+        throw loxc::CacheError{"literal type not serializable"};
+    }
+}
+
+void AstWriter::writeToken(const Token &token)
+{
+    writeU8(token.type);
+    writeString(token.lexeme);
+    writeLiteral(token.literal);
+    writeI32(token.line);
+}
+
+void AstWriter::writeDepth(const Expr *expr)
+{
+    writeI32(expr->depth);
+}
+
+void AstWriter::writeExpr(const std::shared_ptr<Expr> &expr)
+{
+    if (expr == nullptr)
+    {
+        writeU8(NONE);
+        return;
+    }
+    expr->accept(*this);
+}
+
+void AstWriter::writeStmt(const std::shared_ptr<Stmt> &stmt)
+{
+    if (stmt == nullptr)
+    {
+        writeU8(NONE);
+        return;
+    }
+    stmt->accept(*this);
+}
+
+void AstWriter::writeFunction(const FunctionStmt *function)
+{
+    functionIds.emplace(function, functionIds.size());
+
+    writeToken(function->name);
+    writeU32(function->params.size());
+    for (const Token &param : function->params)
+        writeToken(param);
+
+    writeU32(function->body.size());
+    for (const std::shared_ptr<Stmt> &statement : function->body)
+        writeStmt(statement);
+}
+
+void AstWriter::write(const std::vector<std::shared_ptr<Stmt>> &statements)
+{
+    writeU32(statements.size());
+    for (const std::shared_ptr<Stmt> &statement : statements)
+        writeStmt(statement);
+}
+
+uint32_t AstWriter::functionId(const FunctionStmt *function) const
+{
+    auto elem = functionIds.find(function);
+    if (elem == functionIds.end())
+        throw loxc::CacheError{"function was not written"};
+    return elem->second;
+}
+
+std::any AstWriter::visitAssignExpr(AssignExpr *expr)
+{
+    writeU8(ASSIGN_EXPR);
+    writeToken(expr->name);
+    writeExpr(expr->value);
+    writeDepth(expr);
+    return {};
+}
+
+std::any AstWriter::visitBinaryExpr(BinaryExpr *expr)
+{
+    writeU8(BINARY_EXPR);
+    writeExpr(expr->left);
+    writeToken(expr->op);
+    writeExpr(expr->right);
+    return {};
+}
+
+std::any AstWriter::visitGroupingExpr(GroupingExpr *expr)
+{
+    writeU8(GROUPING_EXPR);
+    writeExpr(expr->expression);
+    return {};
+}
+
+std::any AstWriter::visitLiteralExpr(LiteralExpr *expr)
+{
+    writeU8(LITERAL_EXPR);
+    writeLiteral(expr->value);
+    return {};
+}
+
+std::any AstWriter::visitUnaryExpr(UnaryExpr *expr)
+{
+    writeU8(UNARY_EXPR);
+    writeToken(expr->op);
+    writeExpr(expr->right);
+    return {};
+}
+
+std::any AstWriter::visitVariableExpr(VariableExpr *expr)
+{
+    writeU8(VARIABLE_EXPR);
+    writeToken(expr->name);
+    writeDepth(expr);
+    return {};
+}
+
+std::any AstWriter::visitLogicalExpr(LogicalExpr *expr)
+{
+    writeU8(LOGICAL_EXPR);
+    writeExpr(expr->left);
+    writeToken(expr->op);
+    writeExpr(expr->right);
+    return {};
+}
+
+std::any AstWriter::visitCallExpr(CallExpr *expr)
+{
+    writeU8(CALL_EXPR);
+    writeExpr(expr->callee);
+    writeToken(expr->paren);
+    writeU32(expr->arguments.size());
+    for (const std::shared_ptr<Expr> &argument : expr->arguments)
+        writeExpr(argument);
+    return {};
+}
+
+std::any AstWriter::visitGetExpr(GetExpr *expr)
+{
+    writeU8(GET_EXPR);
+    writeExpr(expr->object);
+    writeToken(expr->name);
+    return {};
+}
+
+std::any AstWriter::visitSetExpr(SetExpr *expr)
+{
+    writeU8(SET_EXPR);
+    writeExpr(expr->object);
+    writeToken(expr->name);
+    writeExpr(expr->value);
+    return {};
+}
+
+std::any AstWriter::visitThisExpr(ThisExpr *expr)
+{
+    writeU8(THIS_EXPR);
+    writeToken(expr->keyword);
+    writeDepth(expr);
+    return {};
+}
+
+std::any AstWriter::visitIndexExpr(IndexExpr *expr)
+{
+    writeU8(INDEX_EXPR);
+    writeExpr(expr->object);
+    writeToken(expr->bracket);
+    writeExpr(expr->index);
+    return {};
+}
+
+std::any AstWriter::visitIndexSetExpr(IndexSetExpr *expr)
+{
+    writeU8(INDEX_SET_EXPR);
+    writeExpr(expr->object);
+    writeToken(expr->bracket);
+    writeExpr(expr->index);
+    writeExpr(expr->value);
+    return {};
+}
+
+std::any AstWriter::visitBlockStmt(BlockStmt *stmt)
+{
+    writeU8(BLOCK_STMT);
+    write(stmt->statements);
+    return {};
+}
+
+std::any AstWriter::visitExpressionStmt(ExpressionStmt *stmt)
+{
+    writeU8(EXPRESSION_STMT);
+    writeExpr(stmt->expression);
+    return {};
+}
+
+std::any AstWriter::visitPrintStmt(PrintStmt *stmt)
+{
+    writeU8(PRINT_STMT);
+    writeExpr(stmt->expression);
+    return {};
+}
+
+std::any AstWriter::visitVarStmt(VarStmt *stmt)
+{
+    writeU8(VAR_STMT);
+    writeToken(stmt->name);
+    writeExpr(stmt->initializer);
+    return {};
+}
+
+std::any AstWriter::visitIfStmt(IfStmt *stmt)
+{
+    writeU8(IF_STMT);
+    writeExpr(stmt->condition);
+    writeStmt(stmt->thenBranch);
+    writeStmt(stmt->elseBranch);
+    return {};
+}
+
+std::any AstWriter::visitWhileStmt(WhileStmt *stmt)
+{
+    writeU8(WHILE_STMT);
+    writeExpr(stmt->condition);
+    writeStmt(stmt->body);
+    return {};
+}
+
+std::any AstWriter::visitFunctionStmt(FunctionStmt *stmt)
+{
+    writeU8(FUNCTION_STMT);
+    writeFunction(stmt);
+    return {};
+}
+
+std::any AstWriter::visitReturnStmt(ReturnStmt *stmt)
+{
+    writeU8(RETURN_STMT);
+    writeToken(stmt->keyword);
+    writeExpr(stmt->value);
+    return {};
+}
+
+std::any AstWriter::visitClassStmt(ClassStmt *stmt)
+{
+    writeU8(CLASS_STMT);
+    writeToken(stmt->name);
+    writeU32(stmt->methods.size());
+    for (const std::shared_ptr<FunctionStmt> &method : stmt->methods)
+        writeFunction(method.get());
+    return {};
+}
+
+// ---------------------------------------------------------------- reader
+
+AstReader::AstReader(const char *begin, const char *end)
+    : cursor{begin}, end{end}
+{
+}
+
+void AstReader::need(size_t size)
+{
+    if (static_cast<size_t>(end - cursor) < size)
+        throw loxc::CacheError{"unexpected end of cache"};
+}
+
+uint8_t AstReader::readU8()
+{
+    need(1);
+    return static_cast<uint8_t>(*cursor++);
+}
+
+uint32_t AstReader::readU32()
+{
+    need(4);
+    uint32_t value = getU32(cursor);
+    cursor += 4;
+    return value;
+}
+
+int32_t AstReader::readI32()
+{
+    return static_cast<int32_t>(readU32());
+}
+
+uint64_t AstReader::readU64()
+{
+    need(8);
+    uint64_t value = getU64(cursor);
+    cursor += 8;
+    return value;
+}
+
+std::string AstReader::readString()
+{
+    uint32_t size = readU32();
+    need(size);
+    std::string value{cursor, size};
+    cursor += size;
+    return value;
+}
+
+std::any AstReader::readLiteral()
+{
+    switch (readU8())
+    {
+    case LITERAL_NIL:
+        return nullptr;
+    case LITERAL_FALSE:
+        return false;
+    case LITERAL_TRUE:
+        return true;
+    case LITERAL_NUMBER:
+    {
+        uint64_t bits = readU64();
+        double number;
+        std::memcpy(&number, &bits, sizeof number);
+        return number;
+    }
+    case LITERAL_STRING:
+        return readString();
+    default:
+        throw loxc::CacheError{"bad literal tag"};
+    }
+}
+
+Token AstReader::readToken()
+{
+    uint8_t type = readU8();
+    if (type > END_OF_FILE)
+        throw loxc::CacheError{"bad token type"};
+    std::string lexeme = readString();
+    std::any literal = readLiteral();
+    int line = readI32();
+    return Token{static_cast<TokenType>(type), std::move(lexeme),
+                 std::move(literal), line};
+}
+
+void AstReader::readDepth(Expr *expr)
+{
+    expr->depth = readI32();
+}
+
+std::shared_ptr<Expr> AstReader::readExpr()
+{
+    switch (readU8())
+    {
+    case NONE:
+        return nullptr;
+    case ASSIGN_EXPR:
+    {
+        Token name = readToken();
+        std::shared_ptr<Expr> value = readExpr();
+        auto expr = std::make_shared<AssignExpr>(std::move(name), value);
+        readDepth(expr.get());
+        return expr;
+    }
+    case BINARY_EXPR:
+    {
+        std::shared_ptr<Expr> left = readExpr();
+        Token op = readToken();
+        std::shared_ptr<Expr> right = readExpr();
+        return std::make_shared<BinaryExpr>(left, std::move(op), right);
+    }
+    case GROUPING_EXPR:
+        return std::make_shared<GroupingExpr>(readExpr());
+    case LITERAL_EXPR:
+        return std::make_shared<LiteralExpr>(readLiteral());
+    case UNARY_EXPR:
+    {
+        Token op = readToken();
+        return std::make_shared<UnaryExpr>(std::move(op), readExpr());
+    }
+    case VARIABLE_EXPR:
+    {
+        auto expr = std::make_shared<VariableExpr>(readToken());
+        readDepth(expr.get());
+        return expr;
+    }
+    case LOGICAL_EXPR:
+    {
+        std::shared_ptr<Expr> left = readExpr();
+        Token op = readToken();
+        std::shared_ptr<Expr> right = readExpr();
+        return std::make_shared<LogicalExpr>(left, std::move(op), right);
+    }
+    case CALL_EXPR:
+    {
+        std::shared_ptr<Expr> callee = readExpr();
+        Token paren = readToken();
+        uint32_t count = readU32();
+        need(count);
+        std::vector<std::shared_ptr<Expr>> arguments(count);
+        for (std::shared_ptr<Expr> &argument : arguments)
+            argument = readExpr();
+        return std::make_shared<CallExpr>(callee, std::move(paren),
+                                          std::move(arguments));
+    }
+    case GET_EXPR:
+    {
+        std::shared_ptr<Expr> object = readExpr();
+        return std::make_shared<GetExpr>(object, readToken());
+    }
+    case SET_EXPR:
+    {
+        std::shared_ptr<Expr> object = readExpr();
+        Token name = readToken();
+        std::shared_ptr<Expr> value = readExpr();
+        return std::make_shared<SetExpr>(object, std::move(name), value);
+    }
+    case THIS_EXPR:
+    {
+        auto expr = std::make_shared<ThisExpr>(readToken());
+        readDepth(expr.get());
+        return expr;
+    }
+    case INDEX_EXPR:
+    {
+        std::shared_ptr<Expr> object = readExpr();
+        Token bracket = readToken();
+        std::shared_ptr<Expr> index = readExpr();
+        return std::make_shared<IndexExpr>(object, std::move(bracket), index);
+    }
+    case INDEX_SET_EXPR:
+    {
+        std::shared_ptr<Expr> object = readExpr();
+        Token bracket = readToken();
+        std::shared_ptr<Expr> index = readExpr();
+        std::shared_ptr<Expr> value = readExpr();
+        return std::make_shared<IndexSetExpr>(object, std::move(bracket),
+                                              index, value);
+    }
+    default:
+        throw loxc::CacheError{"bad expression tag"};
+    }
+}
+
+std::vector<std::shared_ptr<Stmt>> AstReader::readStmts()
+{
+    uint32_t count = readU32();
+    need(count); // every statement takes at least its tag byte
+    std::vector<std::shared_ptr<Stmt>> statements(count);
+    for (std::shared_ptr<Stmt> &statement : statements)
+        statement = readStmt();
+    return statements;
+}
+
+std::shared_ptr<FunctionStmt> AstReader::readFunction()
+{
+    // Number functions before their bodies, as the writer does.
+    size_t id = functions.size();
+    functions.emplace_back();
+
+    Token name = readToken();
+    std::vector<Token> params;
+    for (uint32_t i = readU32(); i > 0; --i)
+        params.push_back(readToken());
+
+    auto function = std::make_shared<FunctionStmt>(
+        std::move(name), std::move(params), readStmts());
+    functions[id] = function;
+    return function;
+}
+
+std::shared_ptr<Stmt> AstReader::readStmt()
+{
+    switch (readU8())
+    {
+    case NONE:
+        return nullptr;
+    case BLOCK_STMT:
+        return std::make_shared<BlockStmt>(readStmts());
+    case EXPRESSION_STMT:
+        return std::make_shared<ExpressionStmt>(readExpr());
+    case PRINT_STMT:
+        return std::make_shared<PrintStmt>(readExpr());
+    case VAR_STMT:
+    {
+        Token name = readToken();
+        return std::make_shared<VarStmt>(std::move(name), readExpr());
+    }
+    case IF_STMT:
+    {
+        std::shared_ptr<Expr> condition = readExpr();
+        std::shared_ptr<Stmt> thenBranch = readStmt();
+        std::shared_ptr<Stmt> elseBranch = readStmt();
+        return std::make_shared<IfStmt>(condition, thenBranch, elseBranch);
+    }
+    case WHILE_STMT:
+    {
+        std::shared_ptr<Expr> condition = readExpr();
+        return std::make_shared<WhileStmt>(condition, readStmt());
+    }
+    case FUNCTION_STMT:
+        return readFunction();
+    case RETURN_STMT:
+    {
+        Token keyword = readToken();
+        return std::make_shared<ReturnStmt>(std::move(keyword), readExpr());
+    }
+    case CLASS_STMT:
+    {
+        Token name = readToken();
+        std::vector<std::shared_ptr<FunctionStmt>> methods;
+        for (uint32_t i = readU32(); i > 0; --i)
+            methods.push_back(readFunction());
+        return std::make_shared<ClassStmt>(std::move(name),
+                                           std::move(methods));
+    }
+    default:
+        throw loxc::CacheError{"bad statement tag"};
+    }
+}
+
+std::vector<std::shared_ptr<Stmt>> AstReader::read()
+{
+    return readStmts();
+}
+
+std::shared_ptr<FunctionStmt> AstReader::function(uint32_t id) const
+{
+    if (id >= functions.size())
+        throw loxc::CacheError{"bad function id"};
+    return functions[id];
+}
+
+// ----------------------------------------------------------------- files
+
+bool loxc::writeFile(const std::string &path, std::string_view header,
+                     std::string_view payload)
+{
+    // Unique per writer, so concurrent writers of one path don't mix.
+    std::string temporary =
+        path + "." + std::to_string(getpid()) + "." +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +
+        ".tmp";
+    {
+        std::ofstream file{temporary, std::ios::out | std::ios::binary |
+                                          std::ios::trunc};
+        if (!file)
+            return false;
+        file << header << payload;
+        if (!file.flush())
+        {
+            file.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+loxc::MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                             fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            bytes = static_cast<const char *>(mapping);
+            length = info.st_size;
+        }
+    }
+    close(fd);
+}
+
+loxc::MappedFile::~MappedFile()
+{
+    if (bytes != nullptr)
+        munmap(const_cast<char *>(bytes), length);
+}
+
+bool loadProgramCache(const std::string &path, std::string_view source,
+                      std::vector<std::shared_ptr<Stmt>> &statements)
+{
+    loxc::MappedFile file{path};
+    if (file.size() < HEADER_SIZE)
+        return false;
+
+    const char *data = file.data();
+    size_t size = file.size();
+    const char *payload = data + HEADER_SIZE;
+
+    bool ok = std::memcmp(data, loxc::MAGIC, 4) == 0 &&
+              getU32(data + 4) == loxc::VERSION &&
+              getU64(data + 8) == loxc::hash(source) &&
+              getU64(data + 16) == source.size() &&
+              getU64(data + 24) == size - HEADER_SIZE &&
+              getU64(data + 32) ==
+                  loxc::hash(std::string_view{payload, size - HEADER_SIZE});
+    if (!ok)
+        return false;
+
+    try
+    {
+        AstReader reader{payload, data + size};
+        std::vector<std::shared_ptr<Stmt>> decoded = reader.read();
+        if (reader.position() != data + size)
+            return false;
+
+        statements = std::move(decoded);
+        return true;
+    }
+    catch (const loxc::CacheError &)
+    {
+        return false;
+    }
+}
+
+void writeProgramCache(const std::string &path, std::string_view source,
+                       const std::vector<std::shared_ptr<Stmt>> &statements)
+{
+    AstWriter writer;
+    try
+    {
+        writer.write(statements);
+    }
+    catch (const loxc::CacheError &)
+    {
+        return;
+    }
+
+    const std::string &payload = writer.bytes();
+    std::string header{loxc::MAGIC, 4};
+    putU32(header, loxc::VERSION);
+    putU64(header, loxc::hash(source));
+    putU64(header, source.size());
+    putU64(header, payload.size());
+    putU64(header, loxc::hash(payload));
+
+    loxc::writeFile(path, header, payload);
+}
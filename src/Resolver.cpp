@@ -5,7 +5,7 @@ Resolver::Resolver(Interpreter &interpreter)
 {
 }
 
-std::any Resolver::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
+std::any Resolver::visitBlockStmt(BlockStmt *stmt)
 {
     beginScope();
     resolve(stmt->statements);
@@ -48,7 +48,7 @@ void Resolver::declare(const Token &name)
 
     if (scope.find(name.lexeme) != scope.end())
     {
-        error(name,
+        interpreter.errors.error(name,
               "Already a variable with this name in this scope.");
     }
     scope[name.lexeme] = false;
@@ -62,19 +62,19 @@ void Resolver::define(const Token &name)
     scope[name.lexeme] = true;
 }
 
-void Resolver::resolveLocal(std::shared_ptr<Expr> expr, const Token &name)
+void Resolver::resolveLocal(Expr *expr, const Token &name)
 {
     for (int i = scopes.size() - 1; i >= 0; --i)
     {
         if (scopes[i].find(name.lexeme) != scopes[i].end())
         {
-            interpreter.resolve(expr, scopes.size() - 1 - i);
+            expr->depth = scopes.size() - 1 - i;
             return;
         }
     }
 }
 
-std::any Resolver::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
+std::any Resolver::visitFunctionStmt(FunctionStmt *stmt)
 {
     declare(stmt->name);
     define(stmt->name);
@@ -83,8 +83,7 @@ std::any Resolver::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
     return {};
 }
 
-void Resolver::resolveFunction(
-    std::shared_ptr<FunctionStmt> function, FunctionType type)
+void Resolver::resolveFunction(FunctionStmt *function, FunctionType type)
 {
     FunctionType enclosingFunction = currentFunction;
     currentFunction = type;
@@ -100,7 +99,7 @@ void Resolver::resolveFunction(
     currentFunction = enclosingFunction;
 }
 
-std::any Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt)
+std::any Resolver::visitIfStmt(IfStmt *stmt)
 {
     resolve(stmt->condition);
     resolve(stmt->thenBranch);
@@ -109,31 +108,31 @@ std::any Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
+std::any Resolver::visitPrintStmt(PrintStmt *stmt)
 {
     resolve(stmt->expression);
     return {};
 }
 
 std::any Resolver::visitExpressionStmt(
-    std::shared_ptr<ExpressionStmt> stmt)
+    ExpressionStmt *stmt)
 {
     resolve(stmt->expression);
     return {};
 }
 
-std::any Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
+std::any Resolver::visitReturnStmt(ReturnStmt *stmt)
 {
     if (currentFunction == FunctionType::NONE)
     {
-        error(stmt->keyword, "Can't return from top-level code.");
+        interpreter.errors.error(stmt->keyword, "Can't return from top-level code.");
     }
 
     if (stmt->value != nullptr)
     {
         if (currentFunction == FunctionType::INITIALIZER)
         {
-            ::error(stmt->keyword,
+            interpreter.errors.error(stmt->keyword,
                       "Can't return a value from an initializer.");
         }
         resolve(stmt->value);
@@ -142,7 +141,7 @@ std::any Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitVarStmt(std::shared_ptr<VarStmt> stmt)
+std::any Resolver::visitVarStmt(VarStmt *stmt)
 {
     declare(stmt->name);
     if (stmt->initializer != nullptr)
@@ -153,28 +152,28 @@ std::any Resolver::visitVarStmt(std::shared_ptr<VarStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
+std::any Resolver::visitWhileStmt(WhileStmt *stmt)
 {
     resolve(stmt->condition);
     resolve(stmt->body);
     return {};
 }
 
-std::any Resolver::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
+std::any Resolver::visitAssignExpr(AssignExpr *expr)
 {
     resolve(expr->value);
     resolveLocal(expr, expr->name);
     return {};
 }
 
-std::any Resolver::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
+std::any Resolver::visitBinaryExpr(BinaryExpr *expr)
 {
     resolve(expr->left);
     resolve(expr->right);
     return {};
 }
 
-std::any Resolver::visitCallExpr(std::shared_ptr<CallExpr> expr)
+std::any Resolver::visitCallExpr(CallExpr *expr)
 {
     resolve(expr->callee);
 
@@ -187,32 +186,32 @@ std::any Resolver::visitCallExpr(std::shared_ptr<CallExpr> expr)
 }
 
 std::any Resolver::visitGroupingExpr(
-    std::shared_ptr<GroupingExpr> expr)
+    GroupingExpr *expr)
 {
     resolve(expr->expression);
     return {};
 }
 
-std::any Resolver::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
+std::any Resolver::visitLiteralExpr(LiteralExpr *expr)
 {
     return {};
 }
 
-std::any Resolver::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
+std::any Resolver::visitLogicalExpr(LogicalExpr *expr)
 {
     resolve(expr->left);
     resolve(expr->right);
     return {};
 }
 
-std::any Resolver::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
+std::any Resolver::visitUnaryExpr(UnaryExpr *expr)
 {
     resolve(expr->right);
     return {};
 }
 
 std::any Resolver::visitVariableExpr(
-    std::shared_ptr<VariableExpr> expr)
+    VariableExpr *expr)
 {
     if (!scopes.empty())
     {
@@ -220,7 +219,7 @@ std::any Resolver::visitVariableExpr(
         auto elem = scope.find(expr->name.lexeme);
         if (elem != scope.end() && elem->second == false)
         {
-            error(expr->name,
+            interpreter.errors.error(expr->name,
                   "Can't read local variable in its own initializer.");
         }
     }
@@ -229,7 +228,7 @@ std::any Resolver::visitVariableExpr(
     return {};
 }
 
-std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
+std::any Resolver::visitClassStmt(ClassStmt *stmt)
 {
     ClassType enclosingClass = currentClass;
     currentClass = ClassType::CLASS;
@@ -240,7 +239,7 @@ std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
     beginScope();
     scopes.back()["this"] = true;
 
-    for (auto method : stmt->methods)
+    for (const std::shared_ptr<FunctionStmt> &method : stmt->methods)
     {
         FunctionType declaration = FunctionType::METHOD;
 
@@ -249,7 +248,7 @@ std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
             declaration = FunctionType::INITIALIZER;
         }
 
-        resolveFunction(method, declaration);
+        resolveFunction(method.get(), declaration);
     }
 
     endScope();
@@ -259,24 +258,39 @@ std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitGetExpr(std::shared_ptr<GetExpr> expr)
+std::any Resolver::visitGetExpr(GetExpr *expr)
 {
     resolve(expr->object);
     return {};
 }
 
-std::any Resolver::visitSetExpr(std::shared_ptr<SetExpr> expr)
+std::any Resolver::visitSetExpr(SetExpr *expr)
 {
     resolve(expr->value);
     resolve(expr->object);
     return {};
 }
-std::any Resolver::visitThisExpr(std::shared_ptr<ThisExpr> expr)
+
+std::any Resolver::visitIndexExpr(IndexExpr *expr)
+{
+    resolve(expr->object);
+    resolve(expr->index);
+    return {};
+}
+
+std::any Resolver::visitIndexSetExpr(IndexSetExpr *expr)
+{
+    resolve(expr->value);
+    resolve(expr->object);
+    resolve(expr->index);
+    return {};
+}
+std::any Resolver::visitThisExpr(ThisExpr *expr)
 {
 
     if (currentClass == ClassType::NONE)
     {
-        error(expr->keyword,
+        interpreter.errors.error(expr->keyword,
               "Can't use 'this' outside of a class.");
         return {};
     }
@@ -1,8 +1,8 @@
 #include "Scanner.h"
 #include "Error.h"
 
-Scanner::Scanner(std::string_view source)
-    : source(source)
+Scanner::Scanner(std::string_view source, ErrorReporter &errors)
+    : source(source), errors(errors)
 {
 }
 
@@ -50,7 +50,7 @@ void Scanner::string()
 
     if (isAtEnd())
     {
-        error(line, "Unterminated string.");
+        errors.error(line, "Unterminated string.");
     }
 
     advance();
@@ -119,6 +119,12 @@ void Scanner::scanToken()
     case '}':
         addToken(RIGHT_BRACE);
         break;
+    case '[':
+        addToken(LEFT_BRACKET);
+        break;
+    case ']':
+        addToken(RIGHT_BRACKET);
+        break;
     case ',':
         addToken(COMMA);
         break;
@@ -197,7 +203,7 @@ void Scanner::scanToken()
         }
         else
         {
-            error(line, "Unexpected character.");
+            errors.error(line, "Unexpected character.");
         }
         break;
     }
@@ -0,0 +1,133 @@
+#include "Scheduler.h"
+#include <algorithm>
+
+namespace
+{
+    // Which pool, and which of its workers, the calling thread is.
+    thread_local const Scheduler *currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+
+    std::atomic<bool> started{false};
+}
+
+Scheduler::Scheduler(int threads)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < threads; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < threads; ++i)
+        this->threads.emplace_back([this, i]
+                                   { work(i); });
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock{idleMutex};
+        stopping = true;
+    }
+    idle.notify_all();
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+Scheduler &Scheduler::instance()
+{
+    // Never destroyed: tasks still running when the process exits are
+    // simply abandoned rather than joined.
+    static Scheduler *pool = []
+    {
+        started = true;
+        return new Scheduler;
+    }();
+    return *pool;
+}
+
+bool Scheduler::running()
+{
+    return started;
+}
+
+void Scheduler::submit(Job job)
+{
+    size_t target = currentPool == this ? currentWorker
+                                        : next++ % workers.size();
+    // Counted before it is published, so whoever takes it can't
+    // decrement pending below zero.
+    {
+        std::lock_guard<std::mutex> lock{idleMutex};
+        ++pending;
+    }
+    {
+        std::lock_guard<std::mutex> lock{workers[target]->mutex};
+        workers[target]->jobs.push_back(std::move(job));
+    }
+    idle.notify_one();
+}
+
+bool Scheduler::take(size_t self, Job &job)
+{
+    size_t count = workers.size();
+    if (self < count)
+    {
+        Worker &own = *workers[self];
+        std::lock_guard<std::mutex> lock{own.mutex};
+        if (!own.jobs.empty())
+        {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    size_t start = self < count ? self + 1 : next.load();
+    for (size_t i = 0; i < count; ++i)
+    {
+        Worker &victim = *workers[(start + i) % count];
+        std::lock_guard<std::mutex> lock{victim.mutex};
+        if (!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scheduler::runOne()
+{
+    Job job;
+    if (!take(currentPool == this ? currentWorker : workers.size(), job))
+        return false;
+
+    --pending;
+    job();
+    return true;
+}
+
+void Scheduler::work(size_t self)
+{
+    currentPool = this;
+    currentWorker = self;
+
+    for (;;)
+    {
+        Job job;
+        if (take(self, job))
+        {
+            --pending;
+            job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{idleMutex};
+        idle.wait(lock, [this]
+                  { return stopping || pending > 0; });
+        if (stopping && pending == 0)
+            return;
+    }
+}
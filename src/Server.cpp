@@ -0,0 +1,293 @@
+#include "Server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    volatile sig_atomic_t stopping = 0;
+
+    void onStop(int)
+    {
+        stopping = 1;
+    }
+
+    bool writeAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t got = ::read(fd, data, size);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            data += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    bool writeFrame(int fd, char kind, const char *data, uint32_t size)
+    {
+        char header[5] = {kind};
+        std::memcpy(header + 1, &size, 4);
+        return writeAll(fd, header, 5) && writeAll(fd, data, size);
+    }
+
+    // Turns everything written to a stream into frames on the socket.
+    class FrameBuffer : public std::streambuf
+    {
+        int fd;
+        char kind;
+        char buffer[4096];
+
+    public:
+        FrameBuffer(int fd, char kind)
+            : fd{fd}, kind{kind}
+        {
+            setp(buffer, buffer + sizeof buffer);
+        }
+
+    protected:
+        int sync() override
+        {
+            if (pptr() > pbase())
+                writeFrame(fd, kind, pbase(), pptr() - pbase());
+            setp(buffer, buffer + sizeof buffer);
+            return 0;
+        }
+
+        int_type overflow(int_type c) override
+        {
+            sync();
+            if (c != traits_type::eof())
+            {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+    };
+
+    sockaddr_un address(const std::string &socketPath)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof addr.sun_path)
+        {
+            std::cerr << "Socket path too long: " << socketPath << "\n";
+            std::exit(64);
+        }
+        std::strcpy(addr.sun_path, socketPath.c_str());
+        return addr;
+    }
+
+    [[noreturn]] void work(int listener, const server::Runner &run)
+    {
+        int connection;
+        do
+        {
+            connection = accept(listener, nullptr, nullptr);
+        } while (connection < 0 && errno == EINTR && !stopping);
+        close(listener);
+        if (connection < 0)
+            _exit(0);
+
+        uint32_t length;
+        std::string source;
+        if (!readAll(connection, reinterpret_cast<char *>(&length), 4))
+            _exit(0);
+        source.resize(length);
+        if (!readAll(connection, source.data(), length))
+            _exit(0);
+
+        FrameBuffer out{connection, 'o'};
+        FrameBuffer err{connection, 'e'};
+        std::cout.rdbuf(&out);
+        std::cerr.rdbuf(&err);
+
+        uint32_t status = run(source);
+
+        std::cout.flush();
+        std::cerr.flush();
+        writeFrame(connection, 'x', reinterpret_cast<char *>(&status), 4);
+        close(connection);
+        _exit(0);
+    }
+
+    int open(const std::string &socketPath)
+    {
+        sockaddr_un addr = address(socketPath);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                                sizeof addr) != 0)
+        {
+            std::cerr << "Failed to connect to " << socketPath << ": "
+                      << std::strerror(errno) << "\n";
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // One round trip; output goes to the given streams when non-null.
+    int request(int fd, std::string_view source, std::ostream *out,
+                std::ostream *err)
+    {
+        uint32_t length = source.size();
+        if (!writeAll(fd, reinterpret_cast<char *>(&length), 4) ||
+            !writeAll(fd, source.data(), source.size()))
+        {
+            return 74;
+        }
+
+        std::vector<char> data;
+        for (;;)
+        {
+            char header[5];
+            if (!readAll(fd, header, 5))
+                return 74;
+            uint32_t size;
+            std::memcpy(&size, header + 1, 4);
+            data.resize(size);
+            if (!readAll(fd, data.data(), size))
+                return 74;
+
+            if (header[0] == 'x' && size == 4)
+            {
+                uint32_t status;
+                std::memcpy(&status, data.data(), 4);
+                return status;
+            }
+            std::ostream *stream = header[0] == 'o' ? out : err;
+            if (stream != nullptr)
+                stream->write(data.data(), size);
+        }
+    }
+}
+
+void server::serve(const std::string &socketPath, int workers,
+                   const Runner &run)
+{
+    sockaddr_un addr = address(socketPath);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 ||
+        listen(listener, 128) != 0)
+    {
+        std::cerr << "Failed to listen on " << socketPath << ": "
+                  << std::strerror(errno) << "\n";
+        std::exit(74);
+    }
+
+    struct sigaction action{};
+    action.sa_handler = onStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::vector<pid_t> pool;
+    while (!stopping)
+    {
+        while (static_cast<int>(pool.size()) < workers)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+                work(listener, run);
+            if (pid < 0)
+                break;
+            pool.push_back(pid);
+        }
+
+        pid_t done = waitpid(-1, nullptr, 0);
+        if (done > 0)
+            pool.erase(std::remove(pool.begin(), pool.end(), done), pool.end());
+        else if (errno != EINTR)
+            sleep(1); // fork is failing; don't spin
+    }
+
+    for (pid_t pid : pool)
+        kill(pid, SIGTERM);
+    while (waitpid(-1, nullptr, 0) > 0)
+        ;
+    close(listener);
+    unlink(socketPath.c_str());
+    std::exit(0);
+}
+
+int server::connect(const std::string &socketPath, std::string_view source)
+{
+    int fd = open(socketPath);
+    if (fd < 0)
+        return 74;
+
+    int status = request(fd, source, &std::cout, &std::cerr);
+    close(fd);
+    return status;
+}
+
+int server::benchmark(const std::string &socketPath, std::string_view source,
+                      int repeat)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<double> latencies;
+    int status = 0;
+    for (int i = 0; i < repeat; ++i)
+    {
+        auto start = clock::now();
+        int fd = open(socketPath);
+        if (fd < 0)
+            return 74;
+        status = request(fd, source, nullptr, nullptr);
+        close(fd);
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(clock::now() - start)
+                .count());
+    }
+
+    if (latencies.empty())
+        return status;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p)
+    {
+        return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    std::cerr << "requests: " << latencies.size() << "\n"
+              << "min:    " << latencies.front() << " us\n"
+              << "median: " << percentile(0.5) << " us\n"
+              << "p90:    " << percentile(0.9) << " us\n"
+              << "p99:    " << percentile(0.99) << " us\n"
+              << "max:    " << latencies.back() << " us\n";
+    return status;
+}
@@ -0,0 +1,85 @@
+#include "Stats.h"
+#include <cstdio>
+#include <ostream>
+#include <sys/resource.h>
+
+namespace
+{
+    const char *const counterNames[stats::COUNTERS] = {
+        "tokens", "nodes", "environments", "calls",
+        "instances", "allocations", "bytes_allocated",
+    };
+
+    const char *const phaseNames[stats::PHASES] = {
+        "load", "scan", "parse", "resolve", "interpret",
+    };
+
+    long peakRssKb()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    double milliseconds(stats::Phase phase)
+    {
+        return stats::nanoseconds[phase].load() / 1e6;
+    }
+}
+
+void stats::enable()
+{
+    enabled = true;
+}
+
+void stats::print(std::ostream &out)
+{
+    // Printing allocates too; report what happened before it.
+    uint64_t counts[COUNTERS];
+    for (int counter = 0; counter < COUNTERS; ++counter)
+        counts[counter] = counters[counter].load();
+
+    char line[80];
+    out << "phase            ms\n";
+    for (int phase = 0; phase < PHASES; ++phase)
+    {
+        std::snprintf(line, sizeof line, "%-12s %9.3f\n", phaseNames[phase],
+                      milliseconds(static_cast<Phase>(phase)));
+        out << line;
+    }
+    for (int counter = 0; counter < COUNTERS; ++counter)
+    {
+        std::snprintf(line, sizeof line, "%-16s %12llu\n",
+                      counterNames[counter],
+                      static_cast<unsigned long long>(counts[counter]));
+        out << line;
+    }
+    std::snprintf(line, sizeof line, "%-16s %12ld\n", "peak_rss_kb",
+                  peakRssKb());
+    out << line;
+}
+
+std::string stats::json()
+{
+    uint64_t counts[COUNTERS];
+    for (int counter = 0; counter < COUNTERS; ++counter)
+        counts[counter] = counters[counter].load();
+
+    char number[32];
+    std::string text = "{\"phases_ms\": {";
+    for (int phase = 0; phase < PHASES; ++phase)
+    {
+        std::snprintf(number, sizeof number, "%.3f",
+                      milliseconds(static_cast<Phase>(phase)));
+        text += std::string{phase > 0 ? ", " : ""} + "\"" +
+                phaseNames[phase] + "\": " + number;
+    }
+    text += "}";
+    for (int counter = 0; counter < COUNTERS; ++counter)
+    {
+        text += std::string{", \""} + counterNames[counter] + "\": " +
+                std::to_string(counts[counter]);
+    }
+    text += ", \"peak_rss_kb\": " + std::to_string(peakRssKb()) + "}";
+    return text;
+}
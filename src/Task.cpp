@@ -0,0 +1,476 @@
+#include "Task.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility> // std::move
+#include "Interpreter.h"
+#include "Native.h"
+#include "Scheduler.h"
+#include "Transfer.h"
+
+namespace tasks
+{
+    // A value in transit between interpreters.  It is copied out of the
+    // sender with the sender's globals mapped to a private placeholder,
+    // so no interpreter can reach it until the receiver copies it in.
+    struct Message
+    {
+        Ref<Environment> globals = makeRef<Environment>();
+        std::any value;
+        std::vector<std::shared_ptr<const Program>> programs;
+    };
+
+    struct Task
+    {
+        OutputSink *out;
+        Message start;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        Message result;
+        std::string error;
+        // What the task's interpreter reported, for the spawner to pass
+        // on: its error stream isn't safe to write from other threads.
+        std::string reported;
+    };
+
+    struct Channel
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Message> messages;
+        bool closed = false;
+    };
+}
+
+namespace
+{
+    using tasks::Channel;
+    using tasks::Message;
+    using tasks::Task;
+
+    Message pack(Interpreter &interpreter, const std::any &value,
+                 bool withGlobals)
+    {
+        Message message;
+        Transfer transfer{interpreter.globals, message.globals};
+        if (withGlobals)
+            transfer.copyGlobals();
+        message.value = transfer.copy(value);
+        message.programs = interpreter.retained();
+        return message;
+    }
+
+    std::any unpack(const Message &message, Interpreter &interpreter,
+                    bool withGlobals)
+    {
+        for (const std::shared_ptr<const Program> &program : message.programs)
+            interpreter.retain(program);
+
+        Transfer transfer{message.globals, interpreter.globals};
+        if (withGlobals)
+            transfer.copyGlobals();
+        return transfer.copy(message.value);
+    }
+
+    // Waits for ready() under lock, running queued tasks in between.
+    template <class Ready>
+    void wait(std::unique_lock<std::mutex> &lock,
+              std::condition_variable &condition, Ready ready)
+    {
+        while (!ready())
+        {
+            lock.unlock();
+            bool ran = Scheduler::instance().runOne();
+            lock.lock();
+            if (!ran && !ready())
+                condition.wait_for(lock, std::chrono::milliseconds{1});
+        }
+    }
+
+    // Passes on what a finished task reported, on the spawner's thread.
+    // Called with the task's mutex held.
+    void forward(Task &task, Interpreter &spawner)
+    {
+        spawner.errors.stream() << task.reported;
+        task.reported.clear();
+    }
+
+    void run(Task &task)
+    {
+        Message result;
+        std::string error;
+        std::ostringstream reported;
+        {
+            Interpreter interpreter{*task.out, reported};
+            try
+            {
+                std::any function = unpack(task.start, interpreter, true);
+                std::any value = interpreter.call(
+                    Token{IDENTIFIER, "spawn", nullptr, 0}, function, {});
+                interpreter.runEventLoop();
+                result = pack(interpreter, value, false);
+            }
+            catch (const RuntimeError &e)
+            {
+                error = std::string{e.what()} + " [line " +
+                        std::to_string(e.token.line) + "]";
+            }
+            catch (const NativeError &e)
+            {
+                error = e.what();
+            }
+        }
+        task.start = Message{};
+
+        std::lock_guard<std::mutex> lock{task.mutex};
+        task.result = std::move(result);
+        task.error = std::move(error);
+        task.reported = reported.str();
+        task.done = true;
+        task.finished.notify_all();
+    }
+
+    std::any spawnTask(Interpreter &interpreter,
+                       std::vector<std::any> &arguments)
+    {
+        const std::type_info &type = arguments[0].type();
+        if (type != typeid(Ref<LoxFunction>) && type != typeid(Ref<LoxClass>))
+            throw NativeError{"Can only spawn functions and classes."};
+
+        auto task = std::make_shared<Task>();
+        task->out = &interpreter.output().sink();
+        task->start = pack(interpreter, arguments[0], true);
+
+        // Forget the ones already done, so a loop of spawn and join
+        // doesn't keep every task.
+        std::vector<std::shared_ptr<Task>> &spawned = interpreter.spawnedTasks();
+        spawned.erase(std::remove_if(spawned.begin(), spawned.end(),
+                                     [&](const std::shared_ptr<Task> &other)
+                                     {
+                                         std::lock_guard<std::mutex> lock{other->mutex};
+                                         if (other->done)
+                                             forward(*other, interpreter);
+                                         return other->done;
+                                     }),
+                      spawned.end());
+        spawned.push_back(task);
+
+        Scheduler::instance().submit([task]
+                                     { run(*task); });
+        return task;
+    }
+
+    std::any joinTask(Interpreter &interpreter,
+                      std::vector<std::any> &arguments)
+    {
+        const std::shared_ptr<Task> &task = expect<std::shared_ptr<Task>>(
+            arguments[0], "Can only join tasks.");
+
+        // What was printed so far comes before anything the task prints.
+        interpreter.output().flush();
+
+        // Held while copying the result in: another thread joining the
+        // same task copies out of the same message.
+        std::unique_lock<std::mutex> lock{task->mutex};
+        wait(lock, task->finished, [&]
+             { return task->done; });
+        forward(*task, interpreter);
+        if (!task->error.empty())
+            throw NativeError{"Task failed: " + task->error};
+        return unpack(task->result, interpreter, false);
+    }
+
+    std::any newChannel(Interpreter &, std::vector<std::any> &)
+    {
+        return std::make_shared<Channel>();
+    }
+
+    std::any sendMessage(Interpreter &interpreter,
+                         std::vector<std::any> &arguments)
+    {
+        const std::shared_ptr<Channel> &channel =
+            expect<std::shared_ptr<Channel>>(arguments[0],
+                                             "Can only send to channels.");
+        Message message = pack(interpreter, arguments[1], false);
+
+        {
+            std::lock_guard<std::mutex> lock{channel->mutex};
+            if (channel->closed)
+                throw NativeError{"Channel is closed."};
+            channel->messages.push_back(std::move(message));
+        }
+        channel->ready.notify_one();
+        return nullptr;
+    }
+
+    std::any receiveMessage(Interpreter &interpreter,
+                            std::vector<std::any> &arguments)
+    {
+        const std::shared_ptr<Channel> &channel =
+            expect<std::shared_ptr<Channel>>(arguments[0],
+                                             "Can only receive from channels.");
+
+        interpreter.output().flush();
+
+        Message message;
+        {
+            std::unique_lock<std::mutex> lock{channel->mutex};
+            wait(lock, channel->ready, [&]
+                 { return !channel->messages.empty() || channel->closed; });
+            // A closed and drained channel yields nil.
+            if (channel->messages.empty())
+                return nullptr;
+            message = std::move(channel->messages.front());
+            channel->messages.pop_front();
+        }
+        return unpack(message, interpreter, false);
+    }
+
+    std::any closeChannel(Interpreter &, std::vector<std::any> &arguments)
+    {
+        const std::shared_ptr<Channel> &channel =
+            expect<std::shared_ptr<Channel>>(arguments[0],
+                                             "Can only close channels.");
+        {
+            std::lock_guard<std::mutex> lock{channel->mutex};
+            channel->closed = true;
+        }
+        channel->ready.notify_all();
+        return nullptr;
+    }
+
+    enum class Reducer
+    {
+        NONE,
+        SUM,
+        PRODUCT,
+        MIN,
+        MAX,
+    };
+
+    double identity(Reducer reducer)
+    {
+        switch (reducer)
+        {
+        case Reducer::PRODUCT:
+            return 1;
+        case Reducer::MIN:
+            return std::numeric_limits<double>::infinity();
+        case Reducer::MAX:
+            return -std::numeric_limits<double>::infinity();
+        default:
+            return 0;
+        }
+    }
+
+    double reduce(Reducer reducer, double total, double value)
+    {
+        switch (reducer)
+        {
+        case Reducer::SUM:
+            return total + value;
+        case Reducer::PRODUCT:
+            return total * value;
+        case Reducer::MIN:
+            return std::min(total, value);
+        case Reducer::MAX:
+            return std::max(total, value);
+        default:
+            return total;
+        }
+    }
+
+    struct ParallelLoop
+    {
+        Message function;
+        OutputSink *out;
+        Reducer reducer;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t remaining;
+        std::vector<double> results;
+        std::atomic<bool> failed{false};
+        std::string error;
+        std::string reported; // as for Task
+    };
+
+    void runChunk(ParallelLoop &loop, size_t chunk, double first, double end)
+    {
+        double total = identity(loop.reducer);
+        std::string error;
+        std::ostringstream reported;
+        {
+            Interpreter interpreter{*loop.out, reported};
+            Token token{IDENTIFIER, "parallelFor", nullptr, 0};
+            try
+            {
+                std::any function;
+                {
+                    // Every chunk copies out of the same message.
+                    std::lock_guard<std::mutex> lock{loop.mutex};
+                    Transfer transfer{loop.function.globals,
+                                      interpreter.globals};
+                    transfer.copyGlobals();
+                    function = transfer.copy(loop.function.value);
+                    transfer.freeze();
+                }
+                for (const std::shared_ptr<const Program> &program :
+                     loop.function.programs)
+                {
+                    interpreter.retain(program);
+                }
+
+                for (double i = first; i < end && !loop.failed; ++i)
+                {
+                    std::any value = interpreter.call(token, function, {i});
+                    if (loop.reducer == Reducer::NONE)
+                        continue;
+                    if (value.type() != typeid(double))
+                        throw RuntimeError{token,
+                                           "Only numbers can be reduced."};
+                    total = reduce(loop.reducer, total,
+                                   std::any_cast<double>(value));
+                }
+                interpreter.runEventLoop();
+            }
+            catch (const RuntimeError &e)
+            {
+                error = std::string{e.what()} + " [line " +
+                        std::to_string(e.token.line) + "]";
+            }
+            catch (const NativeError &e)
+            {
+                error = e.what();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{loop.mutex};
+        loop.results[chunk] = total;
+        loop.reported += reported.str();
+        if (!error.empty() && !loop.failed)
+        {
+            loop.failed = true;
+            loop.error = std::move(error);
+        }
+        if (--loop.remaining == 0)
+            loop.finished.notify_all();
+    }
+
+    std::any parallelFor(Interpreter &interpreter,
+                         std::vector<std::any> &arguments)
+    {
+        double start = expect<double>(arguments[0],
+                                      "Range start must be a number.");
+        double end = expect<double>(arguments[1],
+                                    "Range end must be a number.");
+
+        const std::any &function = arguments[2];
+        if (function.type() == typeid(Ref<LoxFunction>))
+        {
+            if (std::any_cast<const Ref<LoxFunction> &>(function)->arity() != 1)
+                throw NativeError{"parallelFor needs a function of one argument."};
+        }
+        else
+        {
+            throw NativeError{"parallelFor needs a function of one argument."};
+        }
+
+        auto loop = std::make_shared<ParallelLoop>();
+        loop->reducer = Reducer::NONE;
+        if (arguments.size() > 3)
+        {
+            const std::string &name = expect<std::string>(
+                arguments[3], "Reducer must be a string.");
+            if (name == "sum")
+                loop->reducer = Reducer::SUM;
+            else if (name == "product")
+                loop->reducer = Reducer::PRODUCT;
+            else if (name == "min")
+                loop->reducer = Reducer::MIN;
+            else if (name == "max")
+                loop->reducer = Reducer::MAX;
+            else
+                throw NativeError{"Unknown reducer '" + name +
+                                  "': use sum, product, min or max."};
+        }
+
+        double count = end > start ? std::ceil(end - start) : 0;
+        if (count == 0)
+            return loop->reducer == Reducer::NONE ? std::any{nullptr}
+                                                  : identity(loop->reducer);
+
+        // A few chunks per worker, so stealing can even out iterations
+        // that take different amounts of time.
+        Scheduler &scheduler = Scheduler::instance();
+        size_t chunks = std::min<double>(count, scheduler.size() * 4);
+        double size = std::ceil(count / chunks);
+        chunks = static_cast<size_t>(std::ceil(count / size));
+
+        interpreter.output().flush();
+        loop->function = pack(interpreter, function, true);
+        loop->out = &interpreter.output().sink();
+        loop->remaining = chunks;
+        loop->results.assign(chunks, identity(loop->reducer));
+
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            double first = start + chunk * size;
+            double last = std::min(end, first + size);
+            scheduler.submit([loop, chunk, first, last]
+                             { runChunk(*loop, chunk, first, last); });
+        }
+
+        std::unique_lock<std::mutex> lock{loop->mutex};
+        wait(lock, loop->finished, [&]
+             { return loop->remaining == 0; });
+        interpreter.errors.stream() << loop->reported;
+        if (loop->failed)
+            throw NativeError{"parallelFor failed: " + loop->error};
+        if (loop->reducer == Reducer::NONE)
+            return nullptr;
+
+        double total = identity(loop->reducer);
+        for (double result : loop->results)
+            total = reduce(loop->reducer, total, result);
+        return total;
+    }
+
+    const Native natives[] = {
+        {"spawn", 1, spawnTask},
+        {"join", 1, joinTask},
+        {"channel", 0, newChannel},
+        {"send", 2, sendMessage},
+        {"receive", 1, receiveMessage},
+        {"close", 1, closeChannel},
+        {"parallelFor", 3, parallelFor, 1},
+    };
+}
+
+void tasks::waitAll(Interpreter &interpreter)
+{
+    std::vector<std::shared_ptr<Task>> &spawned = interpreter.spawnedTasks();
+    for (const std::shared_ptr<Task> &task : spawned)
+    {
+        std::unique_lock<std::mutex> lock{task->mutex};
+        wait(lock, task->finished, [&]
+             { return task->done; });
+        forward(*task, interpreter);
+    }
+    spawned.clear();
+}
+
+void tasks::defineNatives(Environment &globals)
+{
+    for (const Native &native : natives)
+        globals.define(native.name, &native);
+}
@@ -0,0 +1,112 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+namespace
+{
+    struct Event
+    {
+        char name[32]; // truncated, not terminated when full
+        trace::Category category;
+        int line;
+        uint32_t thread;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    const char *const categoryNames[] = {"function", "class", "native",
+                                         "phase"};
+
+    trace::Options options;
+    uint64_t origin;
+
+    std::mutex mutex;
+    // Left uninitialised, so only the pages that get used are touched.
+    std::unique_ptr<Event[]> ring;
+    uint64_t recorded = 0; // ever, so ring[recorded % capacity] is next
+
+    std::atomic<uint32_t> threads{0};
+
+    // Small ids in order of first event, which is what trace viewers
+    // show as the thread's name.
+    uint32_t threadId()
+    {
+        thread_local uint32_t id = ++threads;
+        return id;
+    }
+}
+
+void trace::start(const Options &start)
+{
+    options = start;
+    options.capacity = std::max<size_t>(1, options.capacity);
+    options.every = std::max(1u, options.every);
+    origin = now();
+    ring.reset(new Event[options.capacity]);
+    enabled = true;
+}
+
+bool trace::sampled()
+{
+    thread_local unsigned calls = 0;
+    if (++calls < options.every)
+        return false;
+    calls = 0;
+    return true;
+}
+
+void trace::record(Category category, std::string_view name, int line,
+                   uint64_t start, uint64_t end)
+{
+    if (category != PHASE && end - start < options.minNanoseconds)
+        return;
+
+    Event event;
+    size_t length = std::min(name.size(), sizeof event.name);
+    std::memcpy(event.name, name.data(), length);
+    if (length < sizeof event.name)
+        event.name[length] = '\0';
+    event.category = category;
+    event.line = line;
+    event.thread = threadId();
+    event.start = start;
+    event.end = end;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    ring[recorded++ % options.capacity] = event;
+}
+
+bool trace::write(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    uint64_t kept = std::min<uint64_t>(recorded, options.capacity);
+    int pid = getpid();
+    std::fprintf(file, "{\"displayTimeUnit\": \"ns\", \"otherData\": "
+                       "{\"dropped\": %llu}, \"traceEvents\": [\n",
+                 static_cast<unsigned long long>(recorded - kept));
+    for (uint64_t i = recorded - kept; i < recorded; ++i)
+    {
+        const Event &event = ring[i % options.capacity];
+        // Microseconds, as the format wants, to the nanosecond.
+        std::fprintf(file, "{\"name\": \"%.*s\", \"cat\": \"%s\", "
+                           "\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                           "\"pid\": %d, \"tid\": %u",
+                     static_cast<int>(strnlen(event.name, sizeof event.name)),
+                     event.name, categoryNames[event.category],
+                     (event.start - origin) / 1e3,
+                     (event.end - event.start) / 1e3, pid, event.thread);
+        if (event.line > 0)
+            std::fprintf(file, ", \"args\": {\"line\": %d}", event.line);
+        std::fprintf(file, "}%s\n", i + 1 < recorded ? "," : "");
+    }
+    std::fprintf(file, "]}\n");
+    return std::fclose(file) == 0;
+}
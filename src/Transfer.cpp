@@ -0,0 +1,189 @@
+#include "Transfer.h"
+#include <string>
+#include "Environment.h"
+#include "LoxArray.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "LoxMap.h"
+#include "Native.h"
+#include "Task.h"
+
+Transfer::Transfer(const Ref<Environment> &from, Ref<Environment> to)
+    : from{from.get()}, to{std::move(to)}
+{
+}
+
+std::any Transfer::copy(const std::any &value)
+{
+    const std::type_info &type = value.type();
+    if (type == typeid(nullptr) || type == typeid(bool) ||
+        type == typeid(double) || type == typeid(std::string) ||
+        type == typeid(const Native *) ||
+        type == typeid(std::shared_ptr<tasks::Task>) ||
+        type == typeid(std::shared_ptr<tasks::Channel>))
+    {
+        return value;
+    }
+    if (type == typeid(Ref<LoxFunction>))
+        return copy(std::any_cast<const Ref<LoxFunction> &>(value));
+    if (type == typeid(Ref<LoxClass>))
+        return copy(std::any_cast<const Ref<LoxClass> &>(value));
+    if (type == typeid(Ref<LoxInstance>))
+        return copy(std::any_cast<const Ref<LoxInstance> &>(value));
+    if (type == typeid(Ref<LoxArray>))
+        return copy(std::any_cast<const Ref<LoxArray> &>(value));
+    if (type == typeid(Ref<ArrayMethod>))
+    {
+        const auto &method = std::any_cast<const Ref<ArrayMethod> &>(value);
+        return makeRef<ArrayMethod>(copy(method->receiver), method->method);
+    }
+    if (type == typeid(Ref<LoxMap>))
+        return copy(std::any_cast<const Ref<LoxMap> &>(value));
+    if (type == typeid(Ref<MapMethod>))
+    {
+        const auto &method = std::any_cast<const Ref<MapMethod> &>(value);
+        return makeRef<MapMethod>(copy(method->receiver), method->method);
+    }
+
+    throw NativeError{"Value can't be passed to another task."};
+}
+
+void Transfer::remember(const void *original, std::any copy)
+{
+    copies.emplace(original, std::move(copy));
+    copied.push_back(original);
+}
+
+void Transfer::copyGlobals()
+{
+    for (const auto &[name, value] : from->values)
+    {
+        size_t mark = copied.size();
+        try
+        {
+            to->values[name] = copy(value);
+        }
+        catch (const NativeError &)
+        {
+            // Left undefined, so only code that uses it fails.  What was
+            // copied on the way is incomplete: forget it.
+            for (size_t i = mark; i < copied.size(); ++i)
+                copies.erase(copied[i]);
+            copied.resize(mark);
+        }
+    }
+}
+
+void Transfer::freeze()
+{
+    to->frozen = true;
+    for (const auto &[original, copy] : copies)
+    {
+        if (copy.type() == typeid(Ref<Environment>))
+            std::any_cast<const Ref<Environment> &>(copy)->frozen = true;
+    }
+}
+
+Ref<Environment> Transfer::copy(const Ref<Environment> &environment)
+{
+    if (environment.get() == from)
+        return to;
+
+    auto elem = copies.find(environment.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<Environment>>(elem->second);
+
+    Ref<Environment> result =
+        environment->enclosing != nullptr
+            ? makeRef<Environment>(copy(environment->enclosing))
+            : makeRef<Environment>();
+    remember(environment.get(), result);
+
+    for (const auto &[name, value] : environment->values)
+        result->values[name] = copy(value);
+    return result;
+}
+
+Ref<LoxFunction> Transfer::copy(const Ref<LoxFunction> &function)
+{
+    auto elem = copies.find(function.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<LoxFunction>>(elem->second);
+
+    // Registered before its closure is copied: the closure usually
+    // holds the function itself.
+    auto result = makeRef<LoxFunction>(function->declaration, nullptr,
+                                       function->isInitializer);
+    remember(function.get(), result);
+    result->closure = copy(function->closure);
+    return result;
+}
+
+Ref<LoxClass> Transfer::copy(const Ref<LoxClass> &klass)
+{
+    auto elem = copies.find(klass.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<LoxClass>>(elem->second);
+
+    auto result = makeRef<LoxClass>(
+        klass->name, std::map<std::string, Ref<LoxFunction>>{});
+    remember(klass.get(), result);
+    for (const auto &[name, method] : klass->methods)
+        result->methods[name] = copy(method);
+    return result;
+}
+
+Ref<LoxInstance> Transfer::copy(const Ref<LoxInstance> &instance)
+{
+    auto elem = copies.find(instance.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<LoxInstance>>(elem->second);
+
+    auto result = makeRef<LoxInstance>(copy(instance->klass));
+    remember(instance.get(), result);
+    for (const auto &[name, value] : instance->fields)
+        result->fields[name] = copy(value);
+    return result;
+}
+
+Ref<LoxArray> Transfer::copy(const Ref<LoxArray> &array)
+{
+    auto elem = copies.find(array.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<LoxArray>>(elem->second);
+
+    auto result = makeRef<LoxArray>();
+    remember(array.get(), result);
+    result->boxed = array->boxed;
+    result->numbers = array->numbers;
+    result->values.reserve(array->values.size());
+    for (const std::any &value : array->values)
+        result->values.push_back(copy(value));
+    return result;
+}
+
+Ref<LoxMap> Transfer::copy(const Ref<LoxMap> &map)
+{
+    auto elem = copies.find(map.get());
+    if (elem != copies.end())
+        return std::any_cast<Ref<LoxMap>>(elem->second);
+
+    // Keys are strings and numbers and the table layout depends only on
+    // their hashes, so the index is copied as it is.
+    auto result = makeRef<LoxMap>();
+    remember(map.get(), result);
+    result->control = map->control;
+    result->slots = map->slots;
+    result->live = map->live;
+    result->used = map->used;
+    result->entries.reserve(map->entries.size());
+    for (const LoxMap::Entry &entry : map->entries)
+    {
+        std::any value = entry.key.has_value() ? copy(entry.value)
+                                               : std::any{};
+        result->entries.push_back(
+            LoxMap::Entry{entry.key, std::move(value), entry.hash});
+    }
+    return result;
+}
@@ -1,43 +1,91 @@
+#include <algorithm> // std::max
+#include <cstdlib>  // std::atoi
 #include <cstring>  // std::strerror
 #include <fstream>  // readFile
 #include <iostream> // std::getline
 #include <string>
+#include <string_view>
 #include <vector>
-#include "Scanner.h"
-#include "Error.h"
-#include "Parser.h"
-#include "AstPrinter.h"
-#include "Interpreter.h"
-#include "Resolver.h"
+#include "Lox.h"
+#include "ProgramCache.h"
+#include "HeapImage.h"
+#include "HeapSnapshot.h"
+#include "PerfCounters.h"
+#include "Scheduler.h"
+#include "Server.h"
+#include "Allocations.h"
+#include "Batch.h"
+#include "Coverage.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "Trace.h"
 
-static Interpreter interpreter{};
+static Lox lox{};
 
-void run(std::string_view source)
+// --stats 的输出格式，0 表示关闭
+static enum { NO_STATS, STATS_TEXT, STATS_JSON } statsFormat = NO_STATS;
+
+void printStats()
 {
-    Scanner scanner = {source};
-    std::vector<Token> tokens = scanner.scanTokens();
+    if (statsFormat == STATS_TEXT)
+        stats::print(std::cerr);
+    else
+        std::cerr << stats::json() << "\n";
+}
 
-    // for (const Token &token : tokens)
-    // {
-    //     std::cout << token.toString() << "\n";
-    // }
+// --profile 的输出文件，空表示关闭
+static std::string profilePath;
 
-    Parser parser{tokens};
+void writeProfile()
+{
+    profiler::stop();
+    std::ofstream file{profilePath};
+    profiler::writeFolded(file);
+    if (!file)
+        std::cerr << "Failed to write profile " << profilePath << "\n";
+    profiler::printTop(std::cerr, 20);
+}
 
-    std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+// --trace 的输出文件，空表示关闭
+static std::string tracePath;
 
-    if (hadError) return;
+void writeTrace()
+{
+    if (!trace::write(tracePath))
+        std::cerr << "Failed to write trace " << tracePath << "\n";
+}
 
-    Resolver resolver{interpreter};
-    resolver.resolve(statements);
+// --coverage 的报告文件，空表示关闭
+static std::string coveragePath;
 
-    // std::cout << AstPrinter{}.print(expression) << "\n";
-    if (hadError) return;
+void writeCoverage(std::string_view source, const Program &program)
+{
+    std::ofstream file{coveragePath};
+    coverage::report(file, source, program);
+    if (!file)
+        std::cerr << "Failed to write coverage " << coveragePath << "\n";
+}
+
+// --alloc-profile 的报告文件，空表示关闭
+static std::string allocationsPath;
+
+void writeAllocations()
+{
+    std::ofstream file{allocationsPath};
+    allocations::report(file, lox.interpreter().retained());
+    if (!file)
+        std::cerr << "Failed to write allocations " << allocationsPath << "\n";
+}
+
+// --perf：脚本运行期间的硬件计数器
+static bool perfCounters = false;
 
-    interpreter.interpret(statements);
+void run(std::string_view source)
+{
+    lox.run(source);
 }
 
-void runFile(std::string_view path)
+std::string readFile(std::string_view path)
 {
     // 打开文件并检查是否成功
     std::ifstream file{std::string(path), std::ios::in | std::ios::binary};
@@ -50,16 +98,97 @@ void runFile(std::string_view path)
     }
 
     // 读取文件内容到一个 std::string 对象中
-    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
 
-    run(contents);
+std::shared_ptr<const Program> load(std::string_view path,
+                                    std::string_view source, bool useCache)
+{
+    if (!useCache)
+        return lox.compile(source);
+
+    // 缓存按源码内容哈希校验，失效或损坏时重新编译
+    return lox.compile(source, loxc::cachePath(path));
+}
+
+void exitOnError()
+{
+    if (int code = lox.exitCode(); code != 0)
+        std::exit(code);
+}
+
+void runFile(std::string_view path, bool useCache)
+{
+    std::string contents = readFile(path);
+
+    std::shared_ptr<const Program> program = load(path, contents, useCache);
+    if (program != nullptr && perfCounters)
+    {
+        // 只计运行，不含编译；计数器不可用时只打印原因
+        PerfCounters counters;
+        counters.start();
+        lox.run(program);
+        counters.stop();
+        counters.print(std::cerr);
+    }
+    else if (program != nullptr)
+        lox.run(program);
+
+    // 运行时出错也输出已执行部分的计数；interpret 已等待所有任务结束，
+    // 各线程的计数表不再变化
+    if (!coveragePath.empty() && program != nullptr)
+        writeCoverage(contents, *program);
+
+    exitOnError();
+}
+
+// 运行预加载脚本后把全局状态保存为堆镜像
+void dumpImage(std::string_view imagePath, std::string_view preludePath,
+               bool useCache)
+{
+    std::string contents = readFile(preludePath);
+
+    std::shared_ptr<const Program> program = load(preludePath, contents, useCache);
+    if (program != nullptr)
+        lox.run(program);
+
+    exitOnError();
+
+    if (!HeapImage{}.write(std::string{imagePath}, lox.interpreter()))
+    {
+        std::cerr << "Failed to write image " << imagePath << "\n";
+        std::exit(74);
+    }
+}
 
-    if (hadError)
+// 服务模式：预加载脚本只在主进程中执行一次
+[[noreturn]] void serve(const std::string &socketPath, int workers,
+                        const char *preludePath, bool useCache)
+{
+    if (preludePath != nullptr)
     {
-        std::exit(64);
+        std::string contents = readFile(preludePath);
+        std::shared_ptr<const Program> program =
+            load(preludePath, contents, useCache);
+        if (program != nullptr)
+            lox.run(program);
+        exitOnError();
     }
-    if (hadRuntimeError)
+
+    // 线程池的线程不会被 fork 复制，worker 中的任务将永远不会运行
+    if (Scheduler::running())
+    {
+        std::cerr << "The prelude of a server can't use spawn, parallelFor "
+                     "or readFile: workers are forked from it.\n";
         std::exit(70);
+    }
+
+    server::serve(socketPath, workers, [](std::string_view source)
+                  {
+                      // 每个 worker 使用自己的 epoll 和 eventfd
+                      lox.interpreter().resetEventLoop();
+                      lox.run(source);
+                      return lox.exitCode(); });
 }
 
 void runPrompt()
@@ -72,23 +201,165 @@ void runPrompt()
             break;
 
         run(line);
-        hadError = false;
+        lox.errors().hadError = false;
     }
 }
 
+[[noreturn]] void usage()
+{
+    std::cout << "Usage: cpp-lox [--no-cache] [--stats|--stats-json] [--image file]\n"
+              << "               [--profile file [--profile-hz n]]\n"
+              << "               [--trace file [--trace-buffer n] [--trace-every n]\n"
+              << "                [--trace-min-us n]] [--coverage file]\n"
+              << "               [--alloc-profile file] [--perf] [script]\n"
+              << "       cpp-lox [--no-cache] --dump-image file prelude\n"
+              << "       cpp-lox [--image file] --serve socket [--workers n] [prelude]\n"
+              << "       cpp-lox --connect socket [--repeat n] script\n"
+              << "       cpp-lox [--no-cache] --jobs n [--manifest file] [script...]"
+              << std::endl;
+    std::exit(64);
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc > 2)
+    bool useCache = true;
+    std::string image;
+    std::string dump;
+    std::string serveSocket;
+    std::string connectSocket;
+    int workers = 4;
+    int repeat = 0;
+    int jobs = -1;
+    int profileHz = 1000;
+    trace::Options traceOptions;
+    std::vector<std::string> scripts;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; ++arg)
+    {
+        std::string_view option{argv[arg]};
+        if (option == "--no-cache")
+            useCache = false;
+        else if (option == "--stats")
+            statsFormat = STATS_TEXT;
+        else if (option == "--stats-json")
+            statsFormat = STATS_JSON;
+        else if (option == "--profile" && arg + 1 < argc)
+            profilePath = argv[++arg];
+        else if (option == "--profile-hz" && arg + 1 < argc)
+            profileHz = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--perf")
+            perfCounters = true;
+        else if (option == "--alloc-profile" && arg + 1 < argc)
+            allocationsPath = argv[++arg];
+        else if (option == "--coverage" && arg + 1 < argc)
+            coveragePath = argv[++arg];
+        else if (option == "--trace" && arg + 1 < argc)
+            tracePath = argv[++arg];
+        else if (option == "--trace-buffer" && arg + 1 < argc)
+            traceOptions.capacity = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--trace-every" && arg + 1 < argc)
+            traceOptions.every = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--trace-min-us" && arg + 1 < argc)
+            traceOptions.minNanoseconds = std::max(0, std::atoi(argv[++arg])) * 1000ull;
+        else if (option == "--image" && arg + 1 < argc)
+            image = argv[++arg];
+        else if (option == "--dump-image" && arg + 1 < argc)
+            dump = argv[++arg];
+        else if (option == "--serve" && arg + 1 < argc)
+            serveSocket = argv[++arg];
+        else if (option == "--workers" && arg + 1 < argc)
+            workers = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--connect" && arg + 1 < argc)
+            connectSocket = argv[++arg];
+        else if (option == "--repeat" && arg + 1 < argc)
+            repeat = std::atoi(argv[++arg]);
+        else if (option == "--jobs" && arg + 1 < argc)
+            jobs = std::atoi(argv[++arg]);
+        else if (option == "--manifest" && arg + 1 < argc)
+        {
+            std::vector<std::string> listed = batch::readManifest(argv[++arg]);
+            scripts.insert(scripts.end(), listed.begin(), listed.end());
+            jobs = std::max(jobs, 0);
+        }
+        else
+            usage();
+    }
+
+    // kill -USR2 时在下一条语句前写堆快照
+    HeapSnapshot::installSignalHandler();
+
+    // 退出时（包括出错退出）输出统计
+    if (statsFormat != NO_STATS)
+    {
+        stats::enable();
+        std::atexit(printStats);
+    }
+
+    if (!profilePath.empty())
+    {
+        profiler::start(profileHz);
+        std::atexit(writeProfile);
+    }
+
+    if (!coveragePath.empty())
+        coverage::enable();
+
+    // 退出时全局变量还在，仍引用的对象算作存活
+    if (!allocationsPath.empty())
+    {
+        allocations::enable();
+        std::atexit(writeAllocations);
+    }
+
+    if (!tracePath.empty())
     {
-        std::cout << "Usage: cpp-lox [script]" << std::endl;
-        std::exit(64);
+        trace::start(traceOptions);
+        std::atexit(writeTrace);
     }
-    else if (argc == 2)
+
+    if (jobs >= 0)
     {
-        runFile(argv[1]);
+        scripts.insert(scripts.end(), argv + arg, argv + argc);
+        std::exit(batch::run(scripts, jobs, useCache));
+    }
+
+    if (argc - arg > 1)
+        usage();
+
+    if (!connectSocket.empty())
+    {
+        if (arg == argc)
+            usage();
+        std::string source = readFile(argv[arg]);
+        std::exit(repeat > 0
+                      ? server::benchmark(connectSocket, source, repeat)
+                      : server::connect(connectSocket, source));
+    }
+
+    if (!image.empty() && !HeapImage{}.load(image, lox.interpreter()))
+    {
+        std::cerr << "Failed to load image " << image << "\n";
+        std::exit(74);
+    }
+
+    if (!serveSocket.empty())
+    {
+        serve(serveSocket, workers, arg < argc ? argv[arg] : nullptr,
+              useCache);
+    }
+    else if (!dump.empty())
+    {
+        if (arg == argc)
+            usage();
+        dumpImage(dump, argv[arg], useCache);
+    }
+    else if (arg < argc)
+    {
+        runFile(argv[arg], useCache);
     }
     else
     {
         runPrompt();
     }
-}
\ No newline at end of file
+}